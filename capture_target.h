@@ -0,0 +1,148 @@
+// capture_target.h - What a stream captures: a whole display, one window, or a region of a display
+#pragma once
+
+#include "third_party/json.hpp"
+#include <string>
+#include <functional>
+
+using json = nlohmann::json;
+
+struct CaptureTarget {
+    enum class Type {
+        DISPLAY,
+        WINDOW,
+        REGION
+    };
+
+    // Smallest capture worth encoding, and the largest canvas a window may ask for
+    static constexpr int MIN_SIZE = 64;
+    static constexpr int MAX_SIZE = 8192;
+
+    // Pixel size of a display by index (0 = main), or of a window by id; false if there is none
+    using SizeLookup = std::function<bool(int, int& width, int& height)>;
+
+    Type type = Type::DISPLAY;
+    int display = 0;
+    int window_id = 0;
+    // REGION: rectangle in display pixels. WINDOW: output size, the window's own size unless given.
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    // Pixel size of the captured display, for the region crop
+    int display_width = 0;
+    int display_height = 0;
+
+    // Anything but a full display gets its own canvas sized to the captured pixels
+    bool uses_own_canvas() const {
+        return type != Type::DISPLAY;
+    }
+
+    const char* type_name() const {
+        switch (type) {
+            case Type::WINDOW: return "window";
+            case Type::REGION: return "region";
+            default: return "display";
+        }
+    }
+
+    // Reads the optional "capture" object of a start request, e.g.
+    //   {"type": "region", "display": 0, "x": 0, "y": 0, "width": 1280, "height": 720}
+    //   {"type": "window", "window_id": 4711, "width": 1280, "height": 800}
+    // Regions are validated against the pixel size of the display they are on. A window's explicit
+    // size must be within MIN_SIZE..MAX_SIZE; without one it gets a canvas of its own bounds (the
+    // display's size only if those are unknown).
+    static bool parse(const json& body, const SizeLookup& display_size, const SizeLookup& window_size,
+                      CaptureTarget& target, std::string& error) {
+        const json& capture = body.at("capture");
+        if (!capture.is_object()) {
+            error = "capture must be an object";
+            return false;
+        }
+
+        // value() throws on a wrong type, which would surface as a 500
+        if (capture.contains("type") && !capture["type"].is_string()) {
+            error = "capture.type must be a string";
+            return false;
+        }
+        for (const char* key : {"display", "window_id", "x", "y", "width", "height"}) {
+            if (capture.contains(key) && !capture[key].is_number_integer()) {
+                error = std::string("capture.") + key + " must be an integer";
+                return false;
+            }
+        }
+
+        const std::string type = capture.value("type", std::string("display"));
+        target.display = capture.value("display", 0);
+        if (target.display < 0 || !display_size(target.display, target.display_width, target.display_height)) {
+            error = "capture.display " + std::to_string(target.display) + " does not exist";
+            return false;
+        }
+        target.x = capture.value("x", 0);
+        target.y = capture.value("y", 0);
+        // NV12 needs even dimensions
+        target.width = capture.value("width", 0) & ~1;
+        target.height = capture.value("height", 0) & ~1;
+
+        if (type == "display") {
+            target.type = Type::DISPLAY;
+        } else if (type == "window") {
+            target.type = Type::WINDOW;
+            target.window_id = capture.value("window_id", 0);
+            if (target.window_id <= 0) {
+                error = "capture.window_id is required for window capture";
+                return false;
+            }
+            // An explicit size becomes the canvas as-is, so it is range-checked like a region
+            if (capture.contains("width") || capture.contains("height")) {
+                if (target.width < MIN_SIZE || target.height < MIN_SIZE ||
+                    target.width > MAX_SIZE || target.height > MAX_SIZE) {
+                    error = "capture window width and height must both be between " + std::to_string(MIN_SIZE) +
+                            " and " + std::to_string(MAX_SIZE);
+                    return false;
+                }
+            } else {
+                int window_width = 0, window_height = 0;
+                if (!window_size(target.window_id, window_width, window_height)) {
+                    window_width = target.display_width;
+                    window_height = target.display_height;
+                }
+                target.width = window_width & ~1;
+                target.height = window_height & ~1;
+            }
+        } else if (type == "region") {
+            target.type = Type::REGION;
+            if (target.width < MIN_SIZE || target.height < MIN_SIZE || target.x < 0 || target.y < 0) {
+                error = "capture region must be at least " + std::to_string(MIN_SIZE) + "x" +
+                        std::to_string(MIN_SIZE) + " with a non-negative origin";
+                return false;
+            }
+            if (target.x + target.width > target.display_width || target.y + target.height > target.display_height) {
+                error = "capture region exceeds display " + std::to_string(target.display) + " (" +
+                        std::to_string(target.display_width) + "x" + std::to_string(target.display_height) + ")";
+                return false;
+            }
+        } else {
+            error = "capture.type must be display, window or region";
+            return false;
+        }
+
+        return true;
+    }
+
+    json to_json() const {
+        json result;
+        result["type"] = type_name();
+        result["display"] = display;
+        if (type == Type::WINDOW) result["window_id"] = window_id;
+        if (type == Type::REGION) {
+            result["x"] = x;
+            result["y"] = y;
+        }
+        if (uses_own_canvas()) {
+            result["width"] = width;
+            result["height"] = height;
+        }
+        return result;
+    }
+};
@@ -0,0 +1,415 @@
+// cmaf_muxer.h - Minimal fragmented MP4 (CMAF) writer for one H.264 and one AAC track
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// One encoded access unit staged for the next fragment. Times are in the track's timescale.
+struct CmafSample {
+    uint32_t offset = 0;        // into the track's staged payload
+    uint32_t size = 0;
+    uint32_t duration = 0;
+    int32_t composition_offset = 0;
+    bool sync = false;
+};
+
+// Samples and payload of one track for one fragment; payload is already in MP4 (length-prefixed) form
+struct CmafTrackRun {
+    uint64_t base_decode_time = 0;
+    std::vector<CmafSample> samples;
+    std::vector<uint8_t> payload;
+
+    void clear() {
+        samples.clear();
+        payload.clear();
+    }
+};
+
+class CmafMuxer {
+public:
+    static constexpr uint32_t VIDEO_TRACK = 1;
+    static constexpr uint32_t AUDIO_TRACK = 2;
+    static constexpr uint32_t VIDEO_TIMESCALE = 90000;
+
+private:
+    std::vector<uint8_t> sps;
+    std::vector<uint8_t> pps;
+    std::vector<uint8_t> audio_config;  // AudioSpecificConfig
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t sample_rate = 48000;
+    uint16_t channels = 2;
+
+    // Big-endian box writer over a caller-owned buffer
+    class BoxWriter {
+    private:
+        std::vector<uint8_t>& out;
+        std::vector<size_t> open_boxes;
+
+    public:
+        explicit BoxWriter(std::vector<uint8_t>& buffer) : out(buffer) {}
+
+        void u8(uint8_t v) { out.push_back(v); }
+        void u16(uint16_t v) { u8(static_cast<uint8_t>(v >> 8)); u8(static_cast<uint8_t>(v)); }
+        void u24(uint32_t v) { u8(static_cast<uint8_t>(v >> 16)); u16(static_cast<uint16_t>(v)); }
+        void u32(uint32_t v) { u16(static_cast<uint16_t>(v >> 16)); u16(static_cast<uint16_t>(v)); }
+        void u64(uint64_t v) { u32(static_cast<uint32_t>(v >> 32)); u32(static_cast<uint32_t>(v)); }
+        void zeros(size_t n) { out.insert(out.end(), n, 0); }
+        void bytes(const uint8_t* data, size_t n) { out.insert(out.end(), data, data + n); }
+        void bytes(const std::vector<uint8_t>& data) { bytes(data.data(), data.size()); }
+        void fourcc(const char* code) { bytes(reinterpret_cast<const uint8_t*>(code), 4); }
+
+        size_t position() const { return out.size(); }
+
+        void begin(const char* type) {
+            open_boxes.push_back(out.size());
+            u32(0);
+            fourcc(type);
+        }
+
+        void begin_full(const char* type, uint8_t version, uint32_t flags) {
+            begin(type);
+            u8(version);
+            u24(flags);
+        }
+
+        void end() {
+            const size_t start = open_boxes.back();
+            open_boxes.pop_back();
+            patch_u32(start, static_cast<uint32_t>(out.size() - start));
+        }
+
+        void patch_u32(size_t at, uint32_t v) {
+            out[at] = static_cast<uint8_t>(v >> 24);
+            out[at + 1] = static_cast<uint8_t>(v >> 16);
+            out[at + 2] = static_cast<uint8_t>(v >> 8);
+            out[at + 3] = static_cast<uint8_t>(v);
+        }
+
+        // MPEG-4 descriptor header (ISO 14496-1), sizes here always fit the 4-byte form
+        void descriptor(uint8_t tag, uint32_t size) {
+            u8(tag);
+            u8(static_cast<uint8_t>(0x80 | ((size >> 21) & 0x7F)));
+            u8(static_cast<uint8_t>(0x80 | ((size >> 14) & 0x7F)));
+            u8(static_cast<uint8_t>(0x80 | ((size >> 7) & 0x7F)));
+            u8(static_cast<uint8_t>(size & 0x7F));
+        }
+    };
+
+    static void matrix(BoxWriter& w) {
+        static const uint32_t unity[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+        for (uint32_t v : unity) w.u32(v);
+    }
+
+    void write_track(BoxWriter& w, bool video) const {
+        w.begin("trak");
+
+        w.begin_full("tkhd", 0, 0x000003);      // enabled, in movie
+        w.u32(0);
+        w.u32(0);
+        w.u32(video ? VIDEO_TRACK : AUDIO_TRACK);
+        w.u32(0);
+        w.u32(0);                               // duration unknown (fragmented)
+        w.zeros(8);
+        w.u16(0);
+        w.u16(0);
+        w.u16(video ? 0 : 0x0100);
+        w.u16(0);
+        matrix(w);
+        w.u32(video ? width << 16 : 0);
+        w.u32(video ? height << 16 : 0);
+        w.end();
+
+        w.begin("mdia");
+        w.begin_full("mdhd", 0, 0);
+        w.u32(0);
+        w.u32(0);
+        w.u32(video ? VIDEO_TIMESCALE : sample_rate);
+        w.u32(0);
+        w.u16(0x55C4);                          // "und"
+        w.u16(0);
+        w.end();
+
+        w.begin_full("hdlr", 0, 0);
+        w.u32(0);
+        w.fourcc(video ? "vide" : "soun");
+        w.zeros(12);
+        const char* name = video ? "VideoHandler" : "SoundHandler";
+        w.bytes(reinterpret_cast<const uint8_t*>(name), std::strlen(name) + 1);
+        w.end();
+
+        w.begin("minf");
+        if (video) {
+            w.begin_full("vmhd", 0, 1);
+            w.zeros(8);
+        } else {
+            w.begin_full("smhd", 0, 0);
+            w.zeros(4);
+        }
+        w.end();
+
+        w.begin("dinf");
+        w.begin_full("dref", 0, 0);
+        w.u32(1);
+        w.begin_full("url ", 0, 1);             // media is in the same file
+        w.end();
+        w.end();
+        w.end();
+
+        w.begin("stbl");
+        w.begin_full("stsd", 0, 0);
+        w.u32(1);
+        if (video) {
+            write_avc1(w);
+        } else {
+            write_mp4a(w);
+        }
+        w.end();
+        // Sample tables are empty; every sample lives in a movie fragment
+        for (const char* table : {"stts", "stsc", "stco"}) {
+            w.begin_full(table, 0, 0);
+            w.u32(0);
+            w.end();
+        }
+        w.begin_full("stsz", 0, 0);
+        w.u32(0);
+        w.u32(0);
+        w.end();
+        w.end();    // stbl
+
+        w.end();    // minf
+        w.end();    // mdia
+        w.end();    // trak
+    }
+
+    void write_avc1(BoxWriter& w) const {
+        w.begin("avc1");
+        w.zeros(6);
+        w.u16(1);                               // data_reference_index
+        w.zeros(16);
+        w.u16(static_cast<uint16_t>(width));
+        w.u16(static_cast<uint16_t>(height));
+        w.u32(0x00480000);                      // 72 dpi
+        w.u32(0x00480000);
+        w.u32(0);
+        w.u16(1);                               // frame_count
+        w.zeros(32);                            // compressorname
+        w.u16(0x0018);
+        w.u16(0xFFFF);
+
+        w.begin("avcC");
+        w.u8(1);
+        w.u8(sps[1]);                           // profile, compatibility, level straight from the SPS
+        w.u8(sps[2]);
+        w.u8(sps[3]);
+        w.u8(0xFF);                             // 4-byte NAL lengths
+        w.u8(0xE1);                             // one SPS
+        w.u16(static_cast<uint16_t>(sps.size()));
+        w.bytes(sps);
+        w.u8(1);                                // one PPS
+        w.u16(static_cast<uint16_t>(pps.size()));
+        w.bytes(pps);
+        w.end();
+
+        w.end();
+    }
+
+    void write_mp4a(BoxWriter& w) const {
+        w.begin("mp4a");
+        w.zeros(6);
+        w.u16(1);
+        w.zeros(8);
+        w.u16(channels);
+        w.u16(16);
+        w.u16(0);
+        w.u16(0);
+        w.u32(sample_rate << 16);
+
+        const uint32_t config_size = static_cast<uint32_t>(audio_config.size());
+        const uint32_t decoder_config_size = 13 + 5 + config_size;
+        w.begin_full("esds", 0, 0);
+        w.descriptor(0x03, 3 + 5 + decoder_config_size + 5 + 1);   // ES_Descriptor
+        w.u16(AUDIO_TRACK);                                         // ES_ID
+        w.u8(0);
+        w.descriptor(0x04, decoder_config_size);                    // DecoderConfigDescriptor
+        w.u8(0x40);                                                 // MPEG-4 audio
+        w.u8(0x15);                                                 // audio stream
+        w.u24(0);
+        w.u32(0);
+        w.u32(0);
+        w.descriptor(0x05, config_size);                            // DecoderSpecificInfo
+        w.bytes(audio_config);
+        w.descriptor(0x06, 1);                                      // SLConfigDescriptor
+        w.u8(0x02);
+        w.end();
+
+        w.end();
+    }
+
+    // Writes one traf; returns the position of its trun data_offset field for patching
+    static size_t write_traf(BoxWriter& w, uint32_t track_id, const CmafTrackRun& run, bool video) {
+        w.begin("traf");
+
+        w.begin_full("tfhd", 0, 0x020000);      // default-base-is-moof
+        w.u32(track_id);
+        w.end();
+
+        w.begin_full("tfdt", 1, 0);
+        w.u64(run.base_decode_time);
+        w.end();
+
+        // data-offset, sample-duration, sample-size, sample-flags, (video) composition offsets
+        const uint32_t flags = 0x000001 | 0x000100 | 0x000200 | 0x000400 | (video ? 0x000800 : 0);
+        w.begin_full("trun", 1, flags);
+        w.u32(static_cast<uint32_t>(run.samples.size()));
+        const size_t data_offset_at = w.position();
+        w.u32(0);
+        for (const CmafSample& s : run.samples) {
+            w.u32(s.duration);
+            w.u32(s.size);
+            // sync: depends on nothing; otherwise depends on others and is a non-sync sample
+            w.u32(s.sync ? 0x02000000 : 0x01010000);
+            if (video) w.u32(static_cast<uint32_t>(s.composition_offset));
+        }
+        w.end();
+
+        w.end();
+        return data_offset_at;
+    }
+
+public:
+    // header is the encoder's Annex B extra data (SPS, PPS and possibly SEI)
+    bool set_video_config(const uint8_t* header, size_t size, uint32_t frame_width, uint32_t frame_height) {
+        for_each_nal(header, size, [&](const uint8_t* nal, size_t nal_size) {
+            const uint8_t type = nal[0] & 0x1F;
+            if (type == 7 && sps.empty()) sps.assign(nal, nal + nal_size);
+            if (type == 8 && pps.empty()) pps.assign(nal, nal + nal_size);
+        });
+        width = frame_width;
+        height = frame_height;
+        return sps.size() >= 4 && !pps.empty();
+    }
+
+    // config is the AAC encoder's AudioSpecificConfig
+    bool set_audio_config(const uint8_t* config, size_t size, uint32_t rate) {
+        if (size < 2) return false;
+        audio_config.assign(config, config + size);
+        sample_rate = rate;
+        // 5 bits object type, 4 bits frequency index, 4 bits channel configuration
+        const uint8_t frequency_index = static_cast<uint8_t>(((config[0] & 0x07) << 1) | (config[1] >> 7));
+        if (frequency_index != 15) {
+            const uint16_t channel_config = (config[1] >> 3) & 0x0F;
+            if (channel_config > 0) channels = channel_config == 7 ? 8 : channel_config;
+        }
+        return true;
+    }
+
+    bool has_audio() const {
+        return !audio_config.empty();
+    }
+
+    // Calls fn(nal, size) for every NAL unit in an Annex B byte stream
+    template <typename Fn>
+    static void for_each_nal(const uint8_t* data, size_t size, Fn&& fn) {
+        auto next_start = [&](size_t from, size_t& code_length) {
+            for (size_t j = from; j + 3 <= size; ++j) {
+                if (data[j] == 0 && data[j + 1] == 0) {
+                    if (data[j + 2] == 1) { code_length = 3; return j; }
+                    if (j + 4 <= size && data[j + 2] == 0 && data[j + 3] == 1) { code_length = 4; return j; }
+                }
+            }
+            code_length = 0;
+            return size;
+        };
+
+        size_t code_length = 0;
+        size_t i = next_start(0, code_length);
+        while (i < size) {
+            const size_t nal_begin = i + code_length;
+            const size_t nal_end = next_start(nal_begin, code_length);
+            if (nal_end > nal_begin) fn(data + nal_begin, nal_end - nal_begin);
+            i = nal_end;
+        }
+    }
+
+    // Appends an Annex B access unit to payload as 4-byte length-prefixed NAL units; returns bytes added
+    static uint32_t append_avcc(const uint8_t* data, size_t size, std::vector<uint8_t>& payload) {
+        const size_t before = payload.size();
+        for_each_nal(data, size, [&](const uint8_t* nal, size_t nal_size) {
+            const uint32_t n = static_cast<uint32_t>(nal_size);
+            const uint8_t length[4] = {static_cast<uint8_t>(n >> 24), static_cast<uint8_t>(n >> 16),
+                                       static_cast<uint8_t>(n >> 8), static_cast<uint8_t>(n)};
+            payload.insert(payload.end(), length, length + 4);
+            payload.insert(payload.end(), nal, nal + nal_size);
+        });
+        return static_cast<uint32_t>(payload.size() - before);
+    }
+
+    // ftyp + moov, served as the playlist's EXT-X-MAP
+    void write_init_segment(std::vector<uint8_t>& out) const {
+        BoxWriter w(out);
+
+        w.begin("ftyp");
+        w.fourcc("iso6");
+        w.u32(0);
+        for (const char* brand : {"iso6", "cmfc", "mp41"}) w.fourcc(brand);
+        w.end();
+
+        w.begin("moov");
+        w.begin_full("mvhd", 0, 0);
+        w.u32(0);
+        w.u32(0);
+        w.u32(1000);
+        w.u32(0);
+        w.u32(0x00010000);                      // rate 1.0
+        w.u16(0x0100);                          // volume 1.0
+        w.zeros(10);
+        matrix(w);
+        w.zeros(24);
+        w.u32(has_audio() ? 3 : 2);             // next_track_ID
+        w.end();
+
+        write_track(w, true);
+        if (has_audio()) write_track(w, false);
+
+        w.begin("mvex");
+        for (uint32_t track : {VIDEO_TRACK, AUDIO_TRACK}) {
+            if (track == AUDIO_TRACK && !has_audio()) break;
+            w.begin_full("trex", 0, 0);
+            w.u32(track);
+            w.u32(1);
+            w.u32(0);
+            w.u32(0);
+            w.u32(0);
+            w.end();
+        }
+        w.end();
+        w.end();    // moov
+    }
+
+    // One moof + mdat; mdat holds the video samples followed by the audio samples
+    static void write_fragment(uint32_t sequence, const CmafTrackRun& video, const CmafTrackRun& audio,
+                               std::vector<uint8_t>& out) {
+        BoxWriter w(out);
+        const size_t moof_start = w.position();
+
+        w.begin("moof");
+        w.begin_full("mfhd", 0, 0);
+        w.u32(sequence);
+        w.end();
+        const size_t video_offset_at = write_traf(w, VIDEO_TRACK, video, true);
+        const size_t audio_offset_at = audio.samples.empty() ? 0 : write_traf(w, AUDIO_TRACK, audio, false);
+        w.end();
+
+        const size_t mdat_payload = video.payload.size() + audio.payload.size();
+        w.u32(static_cast<uint32_t>(8 + mdat_payload));
+        w.fourcc("mdat");
+        const size_t video_data = w.position() - moof_start;
+        w.patch_u32(video_offset_at, static_cast<uint32_t>(video_data));
+        if (audio_offset_at) w.patch_u32(audio_offset_at, static_cast<uint32_t>(video_data + video.payload.size()));
+        w.bytes(video.payload);
+        w.bytes(audio.payload);
+    }
+};
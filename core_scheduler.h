@@ -0,0 +1,310 @@
+// core_scheduler.h - Splits the machine's cores between concurrent x264 encoders, keeping some for render/audio/HTTP
+#pragma once
+
+#include "third_party/json.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/types.h>
+#endif
+
+using json = nlohmann::json;
+
+// Thread budget and cores for one stream's encoder
+struct CoreAssignment {
+    int threads = 0;            // x264 "threads=", 0 means no budget (let x264 decide)
+    std::vector<int> cpus;      // empty when affinity is off or unsupported
+};
+
+// Singleton Core Scheduler
+class CoreScheduler {
+private:
+    static inline std::unique_ptr<CoreScheduler> instance;
+    static inline std::mutex instance_mutex;
+
+    struct EncoderThread {
+        int tid;
+        std::string name;       // comm at adoption; a recycled tid comes back under another name
+    };
+
+    struct StreamSlot {
+        std::string stream_id;
+        CoreAssignment assignment;
+        std::vector<EncoderThread> threads;     // x264 threads spawned while the output started
+    };
+
+    mutable std::mutex scheduler_mutex;
+    int cores = 1;
+    int reserved_cores = 2;     // render + audio, HTTP workers
+    bool affinity = false;
+    std::vector<StreamSlot> streams;    // in start order, which fixes each stream's core block
+    uint64_t rebalances = 0;
+
+    CoreScheduler() {
+        cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        if (const char* reserved = std::getenv("SCREENRECORDER_RESERVED_CORES")) {
+            reserved_cores = std::atoi(reserved);
+        }
+        reserved_cores = std::clamp(reserved_cores, 0, std::max(cores - 1, 0));
+#ifdef __linux__
+        if (const char* pin = std::getenv("SCREENRECORDER_ENCODER_AFFINITY")) {
+            affinity = std::string(pin) == "1";
+        }
+#endif
+    }
+
+    static void set_affinity(int tid, const std::vector<int>& cpus) {
+#ifdef __linux__
+        if (cpus.empty()) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) CPU_SET(cpu, &set);
+        sched_setaffinity(tid, sizeof(set), &set);
+#else
+        (void)tid;
+        (void)cpus;
+#endif
+    }
+
+    // Caller holds scheduler_mutex. planned_streams can exceed streams.size() while others are still starting.
+    void rebalance_locked(size_t planned_streams) {
+        const std::vector<CoreAssignment> assignments =
+            plan(cores, reserved_cores, std::max(planned_streams, streams.size()), affinity);
+        for (size_t i = 0; i < streams.size(); ++i) {
+            // x264 fixes its thread count at open; only the core set can follow the new plan
+            streams[i].assignment.cpus = assignments[i].cpus;
+            // Threads that exited (or whose tid now belongs to someone else) must not be pinned
+            auto& threads = streams[i].threads;
+            threads.erase(std::remove_if(threads.begin(), threads.end(),
+                                         [](const EncoderThread& t) { return thread_name(t.tid) != t.name; }),
+                          threads.end());
+            for (const auto& thread : threads) {
+                set_affinity(thread.tid, streams[i].assignment.cpus);
+            }
+        }
+        rebalances++;
+    }
+
+public:
+    static CoreScheduler* getInstance() {
+        std::lock_guard<std::mutex> lock(instance_mutex);
+        if (!instance) {
+            instance = std::unique_ptr<CoreScheduler>(new CoreScheduler());
+        }
+        return instance.get();
+    }
+
+    // Encoder cores are everything past the reserved ones. With fewer streams than encoder cores
+    // each stream gets its own contiguous block (threads = block size); with more, streams share
+    // single cores round-robin with one thread each.
+    static std::vector<CoreAssignment> plan(int total_cores, int reserved, size_t stream_count, bool pin) {
+        std::vector<CoreAssignment> assignments(stream_count);
+        if (stream_count == 0) return assignments;
+
+        const int encoder_cores = std::max(1, total_cores - reserved);
+        const int first = std::min(reserved, total_cores - 1);
+        const size_t n = stream_count;
+
+        if (n <= static_cast<size_t>(encoder_cores)) {
+            const int base = encoder_cores / static_cast<int>(n);
+            const int extra = encoder_cores % static_cast<int>(n);
+            int cpu = first;
+            for (size_t i = 0; i < n; ++i) {
+                const int block = base + (static_cast<int>(i) < extra ? 1 : 0);
+                assignments[i].threads = block;
+                if (pin) {
+                    for (int c = 0; c < block; ++c) assignments[i].cpus.push_back(cpu + c);
+                }
+                cpu += block;
+            }
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                assignments[i].threads = 1;
+                if (pin) assignments[i].cpus.push_back(first + static_cast<int>(i % encoder_cores));
+            }
+        }
+        return assignments;
+    }
+
+    // Restricts the calling thread to a stream's cores for the duration of obs_output_start():
+    // x264 creates its worker/lookahead threads when the encoder opens, and they inherit this mask
+    class ScopedAffinity {
+    private:
+#ifdef __linux__
+        cpu_set_t previous;
+        bool applied = false;
+#endif
+
+    public:
+        explicit ScopedAffinity(const std::vector<int>& cpus) {
+#ifdef __linux__
+            if (!cpus.empty() && sched_getaffinity(0, sizeof(previous), &previous) == 0) {
+                set_affinity(0, cpus);
+                applied = true;
+            }
+#else
+            (void)cpus;
+#endif
+        }
+
+        ~ScopedAffinity() {
+#ifdef __linux__
+            if (applied) sched_setaffinity(0, sizeof(previous), &previous);
+#endif
+        }
+    };
+
+    // Names the calling thread for the duration of obs_output_start(). Threads created meanwhile
+    // inherit the name unless they set their own, so x264's unnamed workers carry the tag while
+    // OBS's named threads and other requests' threads do not.
+    class ScopedThreadTag {
+    private:
+        static inline std::atomic<unsigned> sequence{0};
+        std::string tag;
+#ifdef __linux__
+        char previous[16] = {};
+        bool applied = false;
+#endif
+
+    public:
+        ScopedThreadTag() {
+            char name[16];
+            std::snprintf(name, sizeof(name), "x264tag-%u", sequence.fetch_add(1) % 10000000);
+            tag = name;
+#ifdef __linux__
+            if (prctl(PR_GET_NAME, previous) == 0 && prctl(PR_SET_NAME, tag.c_str()) == 0) {
+                applied = true;
+            }
+#endif
+        }
+
+        ~ScopedThreadTag() {
+#ifdef __linux__
+            if (applied) prctl(PR_SET_NAME, previous);
+#endif
+        }
+
+        const std::string& name() const {
+            return tag;
+        }
+    };
+
+    // comm of one of this process's threads, empty once it has exited
+    static std::string thread_name(int tid) {
+#ifdef __linux__
+        std::ifstream comm("/proc/self/task/" + std::to_string(tid) + "/comm");
+        std::string name;
+        std::getline(comm, name);
+        return name;
+#else
+        (void)tid;
+        return std::string();
+#endif
+    }
+
+    // Encoder threads are the ones x264 names itself or that carry the start's tag
+    static bool is_encoder_thread(const std::string& name, const std::string& tag) {
+        return name == tag || (name.rfind("x264", 0) == 0 && name.rfind("x264tag-", 0) != 0);
+    }
+
+    // Thread ids of this process; diffed around obs_output_start() to find a stream's encoder threads
+    static std::set<int> list_threads() {
+        std::set<int> tids;
+#ifdef __linux__
+        if (DIR* dir = opendir("/proc/self/task")) {
+            while (dirent* entry = readdir(dir)) {
+                if (entry->d_name[0] != '.') tids.insert(std::atoi(entry->d_name));
+            }
+            closedir(dir);
+        }
+#endif
+        return tids;
+    }
+
+    // Budget for a stream about to be created; expected_streams includes it and any still starting
+    CoreAssignment assign(const std::string& stream_id, size_t expected_streams) {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+
+        StreamSlot slot;
+        slot.stream_id = stream_id;
+        slot.assignment.threads = plan(cores, reserved_cores, std::max(expected_streams, streams.size() + 1), affinity)
+                                      [streams.size()].threads;
+        streams.push_back(slot);
+
+        // Running encoders shrink onto their new blocks so the newcomer's cores are free
+        rebalance_locked(expected_streams);
+        return streams.back().assignment;
+    }
+
+    // Keeps the new threads that are this start's encoder threads; anything else another request
+    // or OBS spawned in the same window is left alone
+    void adopt_threads(const std::string& stream_id, const std::set<int>& before, const std::set<int>& after,
+                       const std::string& tag) {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+        for (auto& s : streams) {
+            if (s.stream_id != stream_id) continue;
+            for (int tid : after) {
+                if (before.count(tid)) continue;
+                std::string name = thread_name(tid);
+                if (is_encoder_thread(name, tag)) s.threads.push_back({tid, std::move(name)});
+            }
+            return;
+        }
+    }
+
+    // Stream stopped or failed to start; survivors move up and their encoders spread out
+    void release(const std::string& stream_id) {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+        const auto it = std::find_if(streams.begin(), streams.end(),
+                                     [&](const StreamSlot& s) { return s.stream_id == stream_id; });
+        if (it == streams.end()) return;
+
+        streams.erase(it);
+        rebalance_locked(streams.size());
+        if (affinity) {
+            std::cout << "Rebalanced encoder cores across " << streams.size() << " stream(s)" << std::endl;
+        }
+    }
+
+    CoreAssignment get_assignment(const std::string& stream_id) const {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+        for (const auto& s : streams) {
+            if (s.stream_id == stream_id) return s.assignment;
+        }
+        return CoreAssignment();
+    }
+
+    json get_status() const {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+        json status;
+        status["cores"] = cores;
+        status["reserved_cores"] = reserved_cores;
+        status["encoder_cores"] = std::max(1, cores - reserved_cores);
+        status["affinity"] = affinity;
+        status["rebalances"] = rebalances;
+        status["streams"] = json::array();
+        for (const auto& s : streams) {
+            status["streams"].push_back({
+                {"stream_id", s.stream_id},
+                {"threads", s.assignment.threads},
+                {"cpus", s.assignment.cpus},
+                {"pinned_threads", s.threads.size()}
+            });
+        }
+        return status;
+    }
+};
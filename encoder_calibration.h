@@ -0,0 +1,549 @@
+// encoder_calibration.h - Benchmarks x264 presets/thread counts and picks one that fits a per-machine CPU budget
+#pragma once
+
+#include "third_party/obs/include/obs.h"
+#include "third_party/obs/include/util/platform.h"
+#include "third_party/json.hpp"
+#include "pipeline_trace.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+using json = nlohmann::json;
+
+// One x264 configuration handed to StreamRecorder::setup_encoding()
+struct EncoderProfile {
+    std::string preset = "medium";
+    int threads = 0;             // 0 lets x264 decide
+    double cpu_percent = 0.0;    // measured cost per stream, 0 if uncalibrated
+    bool calibrated = false;
+};
+
+// Measured cost of one candidate on synthetic screen content
+struct CalibrationResult {
+    std::string preset;
+    int threads = 0;
+    double cpu_percent = 0.0;
+    uint32_t skipped_frames = 0;
+    uint32_t total_frames = 0;
+
+    bool sustainable() const {
+        // Allow a single hiccup during warm-up, anything more means the preset can't keep up
+        return total_frames > 0 && skipped_frames <= 1;
+    }
+};
+
+// Synthetic "screen-like" async source: a tall pre-rendered document of text rows and
+// panels that scrolls a few lines per frame. Frames point straight into the document,
+// so the pattern itself costs next to nothing and the encoder dominates the measurement.
+class CalibrationPattern {
+private:
+    obs_source_t* source;
+    uint32_t width;
+    uint32_t height;
+    uint32_t doc_height;
+    uint32_t scroll = 0;
+    std::vector<uint8_t> luma;
+    std::vector<uint8_t> chroma;
+
+    CalibrationPattern(obs_source_t* src, uint32_t w, uint32_t h)
+        : source(src), width(w & ~1u), height(h & ~1u), doc_height((h & ~1u) * 2) {
+        render_document();
+    }
+
+    void render_document() {
+        luma.assign(static_cast<size_t>(width) * doc_height, 235);
+        chroma.assign(static_cast<size_t>(width) * (doc_height / 2), 128);
+
+        uint32_t seed = 0x3c1061c;
+        auto next = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return seed >> 16;
+        };
+
+        // Dark navigation sidebar, like a typical CRM/browser window
+        const uint32_t sidebar = width / 6;
+        for (uint32_t y = 0; y < doc_height; ++y) {
+            std::memset(&luma[static_cast<size_t>(y) * width], 60, sidebar);
+        }
+        for (uint32_t y = 0; y < doc_height / 2; ++y) {
+            uint8_t* row = &chroma[static_cast<size_t>(y) * width];
+            for (uint32_t x = 0; x < sidebar; x += 2) {
+                row[x] = 150;     // U
+                row[x + 1] = 110; // V
+            }
+        }
+
+        // Rows of glyph-like runs with word gaps
+        const uint32_t line_height = 18;
+        const uint32_t glyph_height = 11;
+        for (uint32_t line = 0; line + line_height <= doc_height; line += line_height) {
+            uint32_t x = sidebar + 24;
+            const uint32_t line_end = width - 24 - (next() % (width / 3));
+            while (x < line_end) {
+                const uint32_t word = 12 + next() % 64;
+                for (uint32_t gy = 0; gy < glyph_height; ++gy) {
+                    uint8_t* row = &luma[static_cast<size_t>(line + 4 + gy) * width];
+                    for (uint32_t gx = x; gx < std::min(x + word, line_end); ++gx) {
+                        // Vertical strokes give glyph-like high-frequency detail
+                        if ((gx + gy + (next() & 3)) % 5 < 2) row[gx] = 30;
+                    }
+                }
+                x += word + 8;
+            }
+        }
+    }
+
+    void tick() {
+        // Scroll a few pixel rows per frame; wrap inside the document
+        scroll = (scroll + 4) % (doc_height - height);
+        scroll &= ~1u;
+
+        obs_source_frame2 frame = {};
+        frame.data[0] = &luma[static_cast<size_t>(scroll) * width];
+        frame.data[1] = &chroma[static_cast<size_t>(scroll / 2) * width];
+        frame.linesize[0] = width;
+        frame.linesize[1] = width;
+        frame.width = width;
+        frame.height = height;
+        frame.timestamp = os_gettime_ns();
+        frame.format = VIDEO_FORMAT_NV12;
+        frame.range = VIDEO_RANGE_PARTIAL;
+        video_format_get_parameters_for_format(VIDEO_CS_709, VIDEO_RANGE_PARTIAL, VIDEO_FORMAT_NV12,
+                                               frame.color_matrix, frame.color_range_min,
+                                               frame.color_range_max);
+        obs_source_output_video2(source, &frame);
+    }
+
+    static const char* get_name(void*) {
+        return "Encoder Calibration Pattern";
+    }
+
+    static void* create(obs_data_t* settings, obs_source_t* src) {
+        const auto w = static_cast<uint32_t>(obs_data_get_int(settings, "width"));
+        const auto h = static_cast<uint32_t>(obs_data_get_int(settings, "height"));
+        return new CalibrationPattern(src, w, h);
+    }
+
+    static void destroy(void* data) {
+        delete static_cast<CalibrationPattern*>(data);
+    }
+
+    static void video_tick(void* data, float) {
+        static_cast<CalibrationPattern*>(data)->tick();
+    }
+
+public:
+    static constexpr const char* SOURCE_ID = "calibration_pattern";
+
+    static void register_source() {
+        obs_source_info info = {};
+        info.id = SOURCE_ID;
+        info.type = OBS_SOURCE_TYPE_INPUT;
+        info.output_flags = OBS_SOURCE_ASYNC_VIDEO | OBS_SOURCE_DO_NOT_DUPLICATE;
+        info.get_name = get_name;
+        info.create = create;
+        info.destroy = destroy;
+        info.video_tick = video_tick;
+        obs_register_source(&info);
+    }
+};
+
+// Singleton Encoder Calibrator
+class EncoderCalibrator {
+private:
+    static inline std::unique_ptr<EncoderCalibrator> instance;
+    static inline std::mutex instance_mutex;
+
+    static constexpr const char* CACHE_FILE = "/tmp/3clogic_encoder_calibration.json";
+    static constexpr int CACHE_VERSION = 2;     // 2: threads=1 measured
+    static constexpr uint32_t WARMUP_MS = 1000;
+    static constexpr uint32_t MEASURE_MS = 3000;
+
+    mutable std::mutex calibration_mutex;
+    std::vector<CalibrationResult> results;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t fps = 0;
+    int cores = 0;
+    double cpu_budget = 75.0;   // percent of the whole machine shared by all streams
+    double baseline_cpu = 0.0;
+    EncoderProfile active_profile;
+    size_t active_streams = 0;
+    std::atomic<bool> calibrating{false};
+    std::atomic<bool> cancelled{false};
+
+    EncoderCalibrator() {
+        if (const char* budget = std::getenv("SCREENRECORDER_CPU_BUDGET")) {
+            const double value = std::atof(budget);
+            if (value > 0.0 && value <= 100.0) cpu_budget = value;
+        }
+    }
+
+    // Best quality first; "slow" and above never keep up at Retina sizes
+    static const std::vector<std::string>& candidate_presets() {
+        static const std::vector<std::string> presets = {
+            "medium", "fast", "faster", "veryfast", "superfast", "ultrafast"
+        };
+        return presets;
+    }
+
+    // 1 is what the core scheduler hands out once streams outnumber cores, so it is measured too
+    std::vector<int> candidate_threads() const {
+        std::vector<int> threads = {0, 1, 2};
+        if (cores >= 8) threads.push_back(4);
+        return threads;
+    }
+
+    static int quality_rank(const std::string& preset) {
+        const auto& presets = candidate_presets();
+        const auto it = std::find(presets.begin(), presets.end(), preset);
+        return static_cast<int>(it - presets.begin());
+    }
+
+    // Runs the pattern (and optionally an encoder) on a private view and samples CPU/skips
+    CalibrationResult measure(const std::string& preset, int threads, int bitrate, bool with_encoder) const {
+        CalibrationResult result;
+        result.preset = preset;
+        result.threads = threads;
+
+        obs_data_t* pattern_settings = obs_data_create();
+        obs_data_set_int(pattern_settings, "width", width);
+        obs_data_set_int(pattern_settings, "height", height);
+        obs_source_t* pattern = obs_source_create_private(CalibrationPattern::SOURCE_ID,
+                                                          "Calibration Pattern", pattern_settings);
+        obs_data_release(pattern_settings);
+        if (!pattern) {
+            std::cerr << "Failed to create calibration pattern source" << std::endl;
+            return result;
+        }
+
+        obs_view_t* view = obs_view_create();
+        obs_view_set_source(view, 0, pattern);
+
+        struct obs_video_info ovi = {};
+        obs_get_video_info(&ovi);
+        ovi.base_width = width;
+        ovi.base_height = height;
+        ovi.output_width = width;
+        ovi.output_height = height;
+        ovi.fps_num = fps;
+        ovi.fps_den = 1;
+        video_t* video = obs_view_add2(view, &ovi);
+        // Renders every frame like any mix, so it takes a slot in the per-mix composite order
+        if (video) MixComposites::getInstance()->add_mix(video);
+
+        obs_encoder_t* video_encoder = nullptr;
+        obs_encoder_t* audio_encoder = nullptr;
+        obs_output_t* output = nullptr;
+
+        if (video && with_encoder) {
+            obs_data_t* video_settings = obs_data_create();
+            apply_x264_settings(video_settings, bitrate, EncoderProfile{preset, threads});
+            video_encoder = obs_video_encoder_create("obs_x264", "Calibration Video Encoder",
+                                                     video_settings, nullptr);
+            obs_data_release(video_settings);
+
+            obs_data_t* audio_settings = obs_data_create();
+            obs_data_set_int(audio_settings, "bitrate", 128);
+            audio_encoder = obs_audio_encoder_create("CoreAudio_AAC", "Calibration Audio Encoder",
+                                                     audio_settings, 0, nullptr);
+            obs_data_release(audio_settings);
+
+            output = obs_output_create("null_output", "Calibration Output", nullptr, nullptr);
+
+            if (video_encoder && audio_encoder && output) {
+                obs_encoder_set_video(video_encoder, video);
+                obs_encoder_set_audio(audio_encoder, obs_get_audio());
+                obs_output_set_video_encoder(output, video_encoder);
+                obs_output_set_audio_encoder(output, audio_encoder, 0);
+                if (!obs_output_start(output)) {
+                    std::cerr << "Calibration output failed to start for preset " << preset << std::endl;
+                    obs_output_release(output);
+                    output = nullptr;
+                }
+            }
+        }
+
+        if (video && (!with_encoder || output)) {
+            os_sleep_ms(WARMUP_MS);
+            const uint32_t skipped_start = video_output_get_skipped_frames(video);
+            const uint32_t total_start = video_output_get_total_frames(video);
+            os_cpu_usage_info_t* cpu = os_cpu_usage_info_start();
+            os_sleep_ms(MEASURE_MS);
+            result.cpu_percent = os_cpu_usage_info_query(cpu);
+            os_cpu_usage_info_destroy(cpu);
+            result.skipped_frames = video_output_get_skipped_frames(video) - skipped_start;
+            result.total_frames = video_output_get_total_frames(video) - total_start;
+        }
+
+        if (output) {
+            obs_output_stop(output);
+            int wait_count = 0;
+            while (obs_output_active(output) && wait_count < 30) {
+                os_sleep_ms(100);
+                wait_count++;
+            }
+            if (obs_output_active(output)) {
+                obs_output_force_stop(output);
+            }
+            obs_output_release(output);
+        }
+        if (audio_encoder) obs_encoder_release(audio_encoder);
+        if (video_encoder) obs_encoder_release(video_encoder);
+
+        if (video) MixComposites::getInstance()->remove_mix(video);
+        obs_view_remove(view);
+        obs_view_set_source(view, 0, nullptr);
+        obs_view_destroy(view);
+        obs_source_release(pattern);
+
+        return result;
+    }
+
+    bool load_cache() {
+        std::ifstream in(CACHE_FILE);
+        if (!in) return false;
+
+        try {
+            json cache = json::parse(in);
+            if (cache.value("version", 0) != CACHE_VERSION ||
+                cache.value("width", 0u) != width || cache.value("height", 0u) != height ||
+                cache.value("fps", 0u) != fps || cache.value("cores", 0) != cores) {
+                return false;
+            }
+
+            std::vector<CalibrationResult> loaded;
+            for (const auto& entry : cache.at("results")) {
+                CalibrationResult r;
+                r.preset = entry.at("preset").get<std::string>();
+                r.threads = entry.at("threads").get<int>();
+                r.cpu_percent = entry.at("cpu_percent").get<double>();
+                r.skipped_frames = entry.at("skipped_frames").get<uint32_t>();
+                r.total_frames = entry.at("total_frames").get<uint32_t>();
+                loaded.push_back(r);
+            }
+            baseline_cpu = cache.value("baseline_cpu", 0.0);
+            results = std::move(loaded);
+            return !results.empty();
+        } catch (const std::exception& e) {
+            std::cerr << "Ignoring unreadable encoder calibration cache: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    void save_cache() const {
+        json cache;
+        cache["version"] = CACHE_VERSION;
+        cache["width"] = width;
+        cache["height"] = height;
+        cache["fps"] = fps;
+        cache["cores"] = cores;
+        cache["baseline_cpu"] = baseline_cpu;
+        cache["results"] = results_json();
+
+        std::ofstream out(CACHE_FILE, std::ios::trunc);
+        if (out) {
+            out << cache.dump(2);
+        } else {
+            std::cerr << "Failed to write encoder calibration cache: " << CACHE_FILE << std::endl;
+        }
+    }
+
+    json results_json() const {
+        json list = json::array();
+        for (const auto& r : results) {
+            json entry;
+            entry["preset"] = r.preset;
+            entry["threads"] = r.threads;
+            entry["cpu_percent"] = r.cpu_percent;
+            entry["skipped_frames"] = r.skipped_frames;
+            entry["total_frames"] = r.total_frames;
+            entry["sustainable"] = r.sustainable();
+            list.push_back(entry);
+        }
+        return list;
+    }
+
+    // Caller holds calibration_mutex. max_threads > 0 only considers results measured at that many
+    // threads or fewer; x264's own choice (0) uses every core and never fits a budget.
+    EncoderProfile select_locked(size_t streams, int max_threads = 0) const {
+        EncoderProfile profile;
+        if (results.empty()) {
+            return profile; // uncalibrated: keep the historical "medium" default
+        }
+
+        const double per_stream_budget = cpu_budget / static_cast<double>(std::max<size_t>(streams, 1));
+        const CalibrationResult* best = nullptr;
+        const CalibrationResult* cheapest = nullptr;
+
+        for (const auto& r : results) {
+            if (!r.sustainable()) continue;
+            if (max_threads > 0 && (r.threads == 0 || r.threads > max_threads)) continue;
+            if (!cheapest || r.cpu_percent < cheapest->cpu_percent) cheapest = &r;
+            if (r.cpu_percent > per_stream_budget) continue;
+            if (!best || quality_rank(r.preset) < quality_rank(best->preset) ||
+                (r.preset == best->preset && r.cpu_percent < best->cpu_percent)) {
+                best = &r;
+            }
+        }
+
+        // Over budget everywhere: degrade to the cheapest configuration that still keeps up
+        const CalibrationResult* chosen = best ? best : cheapest;
+        if (!chosen) {
+            profile.preset = "ultrafast";
+            profile.threads = max_threads;
+            profile.calibrated = true;
+            return profile;
+        }
+
+        profile.preset = chosen->preset;
+        profile.threads = chosen->threads;
+        profile.cpu_percent = chosen->cpu_percent;
+        profile.calibrated = true;
+        return profile;
+    }
+
+public:
+    static EncoderCalibrator* getInstance() {
+        std::lock_guard<std::mutex> lock(instance_mutex);
+        if (!instance) {
+            instance = std::unique_ptr<EncoderCalibrator>(new EncoderCalibrator());
+        }
+        return instance.get();
+    }
+
+    // Shared by calibration and StreamRecorder::setup_encoding() so both measure the same thing
+    static void apply_x264_settings(obs_data_t* settings, int bitrate, const EncoderProfile& profile) {
+        obs_data_set_int(settings, "bitrate", bitrate);
+        obs_data_set_string(settings, "preset", profile.preset.c_str());
+        obs_data_set_string(settings, "profile", "high");
+        obs_data_set_string(settings, "tune", "film");
+        obs_data_set_int(settings, "keyint_sec", 2);
+        obs_data_set_string(settings, "rate_control", "CBR");
+        obs_data_set_int(settings, "buffer_size", bitrate);
+        obs_data_set_int(settings, "crf", 18);
+        obs_data_set_bool(settings, "use_bufsize", true);
+        obs_data_set_bool(settings, "psycho_aq", true);
+        obs_data_set_int(settings, "bf", 2);
+        if (profile.threads > 0) {
+            obs_data_set_string(settings, "x264opts", ("threads=" + std::to_string(profile.threads)).c_str());
+        }
+    }
+
+    // Loads the cached table for this resolution/fps/core count, or benchmarks if forced or missing.
+    // The benchmark (up to ~100 s) runs without calibration_mutex: select() and get_status() keep
+    // answering from the previous table, or the default profile, until the new one is in place.
+    // Returns false if another calibration is already running.
+    bool calibrate(uint32_t w, uint32_t h, uint32_t frame_rate, int bitrate, bool force = false) {
+        if (calibrating.exchange(true)) return false;
+        {
+            std::lock_guard<std::mutex> lock(calibration_mutex);
+            width = w;
+            height = h;
+            fps = frame_rate;
+            cores = os_get_logical_cores();
+
+            if (!force && load_cache()) {
+                std::cout << "Loaded encoder calibration for " << width << "x" << height << "@" << fps
+                          << " (" << results.size() << " candidates)" << std::endl;
+                active_profile = select_locked(active_streams + 1);
+                calibrating = false;
+                return true;
+            }
+        }
+
+        std::cout << "Calibrating x264 presets at " << width << "x" << height << "@" << fps
+                  << " on " << cores << " cores, budget " << cpu_budget << "% ..." << std::endl;
+
+        const double measured_baseline = measure("", 0, bitrate, false).cpu_percent;
+        std::vector<CalibrationResult> measured;
+
+        // Cheapest first so we can stop as soon as a preset no longer keeps up at any thread count
+        const auto& presets = candidate_presets();
+        for (auto it = presets.rbegin(); it != presets.rend() && !cancelled; ++it) {
+            bool any_sustainable = false;
+            for (int threads : candidate_threads()) {
+                if (cancelled) break;
+                CalibrationResult r = measure(*it, threads, bitrate, true);
+                r.cpu_percent = std::max(0.0, r.cpu_percent - measured_baseline);
+                std::cout << "  preset=" << r.preset << " threads=" << r.threads
+                          << " cpu=" << r.cpu_percent << "% skipped=" << r.skipped_frames
+                          << "/" << r.total_frames << std::endl;
+                any_sustainable = any_sustainable || r.sustainable();
+                measured.push_back(r);
+            }
+            if (!any_sustainable) break;
+        }
+
+        if (cancelled) {
+            std::cout << "Encoder calibration cancelled" << std::endl;
+            calibrating = false;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(calibration_mutex);
+        baseline_cpu = measured_baseline;
+        results = std::move(measured);
+        save_cache();
+        active_profile = select_locked(active_streams + 1);
+        calibrating = false;
+        std::cout << "Encoder calibration complete, next stream uses preset " << active_profile.preset << std::endl;
+        return !results.empty();
+    }
+
+    bool is_calibrating() const {
+        return calibrating;
+    }
+
+    // Shutdown: a running benchmark stops after the candidate it is measuring (at most ~4 s)
+    void cancel() {
+        cancelled = true;
+    }
+
+    // Profile for a new encoder given how many streams will be running once it starts and the
+    // x264 thread budget the core scheduler gave it (0 = none)
+    EncoderProfile select(size_t streams, int max_threads = 0) const {
+        std::lock_guard<std::mutex> lock(calibration_mutex);
+        return select_locked(streams, max_threads);
+    }
+
+    // Called whenever streams are added or removed; x264 can't change preset mid-stream,
+    // so the new selection applies to the next encoder that gets created.
+    void on_stream_count_changed(size_t streams) {
+        std::lock_guard<std::mutex> lock(calibration_mutex);
+        active_streams = streams;
+        EncoderProfile next = select_locked(streams + 1);
+        if (next.preset != active_profile.preset || next.threads != active_profile.threads) {
+            std::cout << "Encoder profile for next stream (" << streams << " active): preset "
+                      << next.preset << ", threads " << next.threads << std::endl;
+        }
+        active_profile = next;
+    }
+
+    json get_status() const {
+        std::lock_guard<std::mutex> lock(calibration_mutex);
+        json status;
+        status["calibrated"] = !results.empty();
+        status["calibrating"] = calibrating.load();
+        status["cpu_budget_percent"] = cpu_budget;
+        status["active_streams"] = active_streams;
+        status["next_profile"] = {
+            {"preset", active_profile.preset},
+            {"threads", active_profile.threads},
+            {"cpu_percent", active_profile.cpu_percent}
+        };
+        status["resolution"] = std::to_string(width) + "x" + std::to_string(height);
+        status["fps"] = fps;
+        status["baseline_cpu_percent"] = baseline_cpu;
+        status["results"] = results_json();
+        return status;
+    }
+};
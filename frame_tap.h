@@ -0,0 +1,128 @@
+// frame_tap.h - Per-stream opt-in publisher of the stream's NV12 video into a FrameTapWriter ring
+#pragma once
+
+#include "third_party/obs/include/obs.h"
+#include "third_party/json.hpp"
+#include "frame_tap_ring.h"
+#include "latency_histogram.h"
+#include <iostream>
+#include <string>
+#include <atomic>
+
+using json = nlohmann::json;
+
+struct FrameTapConfig {
+    uint32_t slots = 4;             // ring depth; readers more than this many frames behind skip ahead
+    uint32_t fps_divisor = 1;       // publish every Nth output frame
+
+    // Reads the optional "frame_tap" member of a start request: true or {"slots":N,"fps_divisor":N}
+    static bool parse(const json& body, FrameTapConfig& config, std::string& error) {
+        const json& tap = body.at("frame_tap");
+        if (tap.is_boolean()) return true;
+        if (!tap.is_object()) {
+            error = "frame_tap must be true or an object";
+            return false;
+        }
+
+        // value() throws on a wrong type, which would surface as a 500
+        for (const char* key : {"slots", "fps_divisor"}) {
+            if (tap.contains(key) && !tap[key].is_number_integer()) {
+                error = std::string("frame_tap.") + key + " must be an integer";
+                return false;
+            }
+        }
+
+        config.slots = tap.value("slots", config.slots);
+        config.fps_divisor = tap.value("fps_divisor", config.fps_divisor);
+        if (config.slots < 2 || config.slots > 32 || config.fps_divisor < 1 || config.fps_divisor > 60) {
+            error = "frame_tap.slots must be 2-32 and fps_divisor 1-60";
+            return false;
+        }
+        return true;
+    }
+};
+
+// OBS converts the stream's video to NV12 once for all raw callbacks sharing the same conversion,
+// and the callback runs on the video output thread; the only per-frame work here is the ring write.
+class FrameTap {
+private:
+    std::string stream_id;
+    FrameTapConfig config;
+    FrameTapWriter writer;
+    video_t* video = nullptr;
+    bool connected = false;
+    LatencyHistogram write_us;
+    std::atomic<uint64_t> frames{0};
+
+    static void raw_video_callback(void* param, struct video_data* frame) {
+        auto* self = static_cast<FrameTap*>(param);
+        const uint64_t started = frame_tap_now_ns();
+        self->writer.publish(frame->data[0], frame->linesize[0], frame->data[1], frame->linesize[1],
+                             frame->timestamp);
+        self->write_us.record((frame_tap_now_ns() - started) / 1000);
+        self->frames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+public:
+    FrameTap(std::string id, FrameTapConfig cfg) : stream_id(std::move(id)), config(cfg) {}
+
+    ~FrameTap() {
+        stop();
+    }
+
+    // source is the stream's own canvas for window/region capture, otherwise the main mix. The
+    // recording encoder is already active on it, so OBS is reading frames back from the GPU anyway.
+    bool start(video_t* source) {
+        const struct video_output_info* voi = video_output_get_info(source);
+        if (!voi) {
+            return false;
+        }
+
+        if (!writer.create(frame_tap_shm_name(stream_id), voi->width, voi->height, config.slots)) {
+            std::cerr << "Failed to create frame tap ring for stream: " << stream_id << std::endl;
+            return false;
+        }
+
+        struct video_scale_info conversion = {};
+        conversion.format = VIDEO_FORMAT_NV12;
+        conversion.width = voi->width;
+        conversion.height = voi->height;
+        conversion.range = voi->range;
+        conversion.colorspace = voi->colorspace;
+        if (!video_output_connect2(source, &conversion, config.fps_divisor, raw_video_callback, this)) {
+            writer.close();
+            return false;
+        }
+        video = source;
+        connected = true;
+
+        std::cout << "Frame tap started for stream " << stream_id << ": shm " << writer.get_name()
+                  << " (" << voi->width << "x" << voi->height << " NV12, "
+                  << config.slots << " slots)" << std::endl;
+        return true;
+    }
+
+    // Disconnect first so the video thread is done with the ring before it is unmapped
+    void stop() {
+        if (connected) {
+            video_output_disconnect(video, raw_video_callback, this);
+            connected = false;
+        }
+        writer.close();
+    }
+
+    json get_status() const {
+        json status;
+        status["shm_name"] = writer.get_name();
+        status["slots"] = config.slots;
+        status["fps_divisor"] = config.fps_divisor;
+        status["frame_bytes"] = writer.get_frame_bytes();
+        status["frames_published"] = frames.load(std::memory_order_relaxed);
+        status["write_ms"] = {
+            {"p50", write_us.percentile(0.50) / 1000.0},
+            {"p99", write_us.percentile(0.99) / 1000.0},
+            {"max", write_us.max() / 1000.0}
+        };
+        return status;
+    }
+};
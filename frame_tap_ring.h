@@ -0,0 +1,396 @@
+// frame_tap_ring.h - Shared-memory NV12 frame ring (single producer, any number of readers).
+// No OBS dependency: the recorder publishes through FrameTapWriter and out-of-process
+// consumers (redaction, OCR sidecars) include this header and use FrameTapReader.
+//
+// Protocol: every slot carries a sequence word used as a seqlock. The producer stores
+// 2*frame+1 before writing a slot and 2*frame+2 after, then advances the header's
+// latest_frame. Readers never write to the mapping; they jump to latest_frame, check the
+// slot sequence before and after touching the pixels, and retry or skip if it moved. A slow
+// reader therefore only ever loses frames, the producer never waits for anyone.
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <string>
+#include <time.h>
+
+static constexpr uint32_t FRAME_TAP_MAGIC = 0x50415433; // "3TAP"
+static constexpr uint32_t FRAME_TAP_VERSION = 1;
+static constexpr uint64_t FRAME_TAP_NO_FRAME = ~0ULL;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "frame tap needs address-free 64-bit atomics");
+
+struct alignas(64) FrameTapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t slot_count;
+    uint32_t y_linesize;        // == width, planes are packed in the slot
+    uint32_t uv_linesize;
+    uint32_t producer_pid;
+    uint64_t slot_stride;       // bytes from one FrameTapSlot to the next
+    uint64_t frame_bytes;       // Y plane + interleaved UV plane
+    alignas(64) std::atomic<uint64_t> latest_frame; // FRAME_TAP_NO_FRAME until the first publish
+    std::atomic<uint64_t> closed;                   // set when the producer goes away
+};
+
+struct alignas(64) FrameTapSlot {
+    std::atomic<uint64_t> sequence;
+    uint64_t frame_number;
+    uint64_t timestamp_ns;      // OBS video timestamp of the frame
+    uint64_t publish_ns;        // CLOCK_MONOTONIC when the write completed
+    // NV12 pixels follow at the next 64-byte boundary
+};
+
+inline uint64_t frame_tap_now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// POSIX shm names are a single path component and macOS caps them at PSHMNAMLEN (31), which
+// leaves 18 characters for the id. A readable prefix plus a hash of the full id keeps ids that
+// only differ after the prefix, or in characters sanitized to '_', on distinct segments.
+inline std::string frame_tap_shm_name(const std::string& stream_id) {
+    uint32_t hash = 2166136261u;    // FNV-1a
+    for (char c : stream_id) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    std::string name = "/3clogic_tap_";
+    for (size_t i = 0; i < stream_id.size() && i < 9; ++i) {
+        const char c = stream_id[i];
+        name += (isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_') ? c : '_';
+    }
+    char suffix[10];
+    std::snprintf(suffix, sizeof(suffix), "_%08x", hash);
+    return name + suffix;
+}
+
+class FrameTapWriter {
+private:
+    std::string name;
+    uint8_t* base = nullptr;
+    size_t mapped_size = 0;
+    FrameTapHeader* header = nullptr;
+    uint64_t next_frame = 0;
+    dev_t segment_dev = 0;          // identity of the segment we created, so close() never
+    ino_t segment_ino = 0;          // unlinks a newer segment that reuses the name
+
+    bool still_owns_name() const {
+        const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        struct stat st;
+        const bool same = fstat(fd, &st) == 0 && st.st_dev == segment_dev && st.st_ino == segment_ino;
+        ::close(fd);
+        return same;
+    }
+
+public:
+    FrameTapWriter() = default;
+    FrameTapWriter(const FrameTapWriter&) = delete;
+    FrameTapWriter& operator=(const FrameTapWriter&) = delete;
+
+    ~FrameTapWriter() {
+        close();
+    }
+
+    // True if shm_name belongs to a producer that is still publishing: the header is valid, not
+    // closed, and its pid is alive. Anything else under the name is left over from a crash.
+    static bool in_use(const std::string& shm_name) {
+        const int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+
+        struct stat st;
+        bool live = false;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(FrameTapHeader)) {
+            void* mapping = mmap(nullptr, sizeof(FrameTapHeader), PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping != MAP_FAILED) {
+                const auto* existing = static_cast<const FrameTapHeader*>(mapping);
+                live = existing->magic == FRAME_TAP_MAGIC &&
+                       !existing->closed.load(std::memory_order_acquire) &&
+                       !(kill(static_cast<pid_t>(existing->producer_pid), 0) != 0 && errno == ESRCH);
+                munmap(mapping, sizeof(FrameTapHeader));
+            }
+        }
+        ::close(fd);
+        return live;
+    }
+
+    // Fails without touching the segment if another live producer owns shm_name
+    bool create(const std::string& shm_name, uint32_t width, uint32_t height, uint32_t slot_count) {
+        if (width == 0 || height == 0 || (width & 1) || (height & 1) || slot_count < 2) return false;
+
+        const uint64_t frame_bytes = static_cast<uint64_t>(width) * height * 3 / 2;
+        const uint64_t slot_stride = (sizeof(FrameTapSlot) + frame_bytes + 4095) & ~4095ULL;
+        const size_t size = static_cast<size_t>(4096 + slot_stride * slot_count);
+
+        int fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 && errno == EEXIST && !in_use(shm_name)) {
+            // A crashed previous run left the name behind
+            shm_unlink(shm_name.c_str());
+            fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        }
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            shm_unlink(shm_name.c_str());
+            return false;
+        }
+
+        void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            shm_unlink(shm_name.c_str());
+            return false;
+        }
+
+        name = shm_name;
+        base = static_cast<uint8_t*>(mapping);
+        mapped_size = size;
+        segment_dev = st.st_dev;
+        segment_ino = st.st_ino;
+
+        header = new (base) FrameTapHeader();
+        header->magic = FRAME_TAP_MAGIC;
+        header->version = FRAME_TAP_VERSION;
+        header->width = width;
+        header->height = height;
+        header->slot_count = slot_count;
+        header->y_linesize = width;
+        header->uv_linesize = width;
+        header->producer_pid = static_cast<uint32_t>(getpid());
+        header->slot_stride = slot_stride;
+        header->frame_bytes = frame_bytes;
+        header->closed.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < slot_count; ++i) {
+            new (slot(i)) FrameTapSlot();
+            slot(i)->sequence.store(0, std::memory_order_relaxed);
+        }
+        header->latest_frame.store(FRAME_TAP_NO_FRAME, std::memory_order_release);
+        return true;
+    }
+
+    void close() {
+        if (!base) return;
+        header->closed.store(1, std::memory_order_release);
+        munmap(base, mapped_size);
+        if (still_owns_name()) shm_unlink(name.c_str());
+        base = nullptr;
+        header = nullptr;
+    }
+
+    FrameTapSlot* slot(uint64_t index) const {
+        return reinterpret_cast<FrameTapSlot*>(base + 4096 + header->slot_stride * index);
+    }
+
+    static uint8_t* pixels(FrameTapSlot* s) {
+        return reinterpret_cast<uint8_t*>(s) + sizeof(FrameTapSlot);
+    }
+
+    // The one copy per frame: strided source planes into the packed slot
+    uint64_t publish(const uint8_t* y, uint32_t y_linesize, const uint8_t* uv, uint32_t uv_linesize,
+                     uint64_t timestamp_ns) {
+        const uint64_t frame = next_frame++;
+        FrameTapSlot* s = slot(frame % header->slot_count);
+
+        s->sequence.store(frame * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        uint8_t* dst = pixels(s);
+        const uint32_t w = header->width;
+        const uint32_t h = header->height;
+        if (y_linesize == w && uv_linesize == w) {
+            std::memcpy(dst, y, static_cast<size_t>(w) * h);
+            std::memcpy(dst + static_cast<size_t>(w) * h, uv, static_cast<size_t>(w) * h / 2);
+        } else {
+            for (uint32_t row = 0; row < h; ++row) {
+                std::memcpy(dst + static_cast<size_t>(row) * w, y + static_cast<size_t>(row) * y_linesize, w);
+            }
+            uint8_t* dst_uv = dst + static_cast<size_t>(w) * h;
+            for (uint32_t row = 0; row < h / 2; ++row) {
+                std::memcpy(dst_uv + static_cast<size_t>(row) * w, uv + static_cast<size_t>(row) * uv_linesize, w);
+            }
+        }
+
+        s->frame_number = frame;
+        s->timestamp_ns = timestamp_ns;
+        s->publish_ns = frame_tap_now_ns();
+        s->sequence.store(frame * 2 + 2, std::memory_order_release);
+        header->latest_frame.store(frame, std::memory_order_release);
+        return frame;
+    }
+
+    uint64_t frames_published() const {
+        return next_frame;
+    }
+
+    const std::string& get_name() const {
+        return name;
+    }
+
+    uint64_t get_frame_bytes() const {
+        return header ? header->frame_bytes : 0;
+    }
+};
+
+// Consumer side. Typical loop:
+//   FrameTapReader reader;
+//   reader.open(frame_tap_shm_name("call-42"));
+//   FrameTapReader::Frame frame;
+//   while (reader.next(frame)) { process(frame.y, frame.uv); if (!reader.still_valid(frame)) discard(); }
+class FrameTapReader {
+public:
+    struct Frame {
+        uint64_t frame_number = 0;
+        uint64_t timestamp_ns = 0;
+        uint64_t publish_ns = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        const uint8_t* y = nullptr;     // width x height, linesize width
+        const uint8_t* uv = nullptr;    // width x height/2 interleaved CbCr, linesize width
+        const FrameTapSlot* slot = nullptr;
+    };
+
+private:
+    const uint8_t* base = nullptr;
+    size_t mapped_size = 0;
+    const FrameTapHeader* header = nullptr;
+    uint64_t last_frame = FRAME_TAP_NO_FRAME;
+    uint64_t skipped = 0;
+    uint64_t torn = 0;
+
+    const FrameTapSlot* slot(uint64_t index) const {
+        return reinterpret_cast<const FrameTapSlot*>(base + 4096 + header->slot_stride * index);
+    }
+
+public:
+    FrameTapReader() = default;
+    FrameTapReader(const FrameTapReader&) = delete;
+    FrameTapReader& operator=(const FrameTapReader&) = delete;
+
+    ~FrameTapReader() {
+        close();
+    }
+
+    bool open(const std::string& shm_name) {
+        const int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FrameTapHeader)) {
+            ::close(fd);
+            return false;
+        }
+
+        void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) return false;
+
+        base = static_cast<const uint8_t*>(mapping);
+        mapped_size = static_cast<size_t>(st.st_size);
+        header = reinterpret_cast<const FrameTapHeader*>(base);
+
+        if (header->magic != FRAME_TAP_MAGIC || header->version != FRAME_TAP_VERSION ||
+            4096 + header->slot_stride * header->slot_count > mapped_size) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (!base) return;
+        munmap(const_cast<uint8_t*>(base), mapped_size);
+        base = nullptr;
+        header = nullptr;
+    }
+
+    bool producer_closed() const {
+        return !header || header->closed.load(std::memory_order_acquire);
+    }
+
+    // Newest frame not seen yet, without copying. Returns false if nothing new is available.
+    // Anything published in between is counted as skipped.
+    bool try_next(Frame& frame) {
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            const uint64_t latest = header->latest_frame.load(std::memory_order_acquire);
+            if (latest == FRAME_TAP_NO_FRAME || latest == last_frame) return false;
+
+            const FrameTapSlot* s = slot(latest % header->slot_count);
+            const uint64_t sequence = s->sequence.load(std::memory_order_acquire);
+            if (sequence != latest * 2 + 2) {
+                torn++; // lapped between the two loads; go again with the new latest
+                continue;
+            }
+
+            frame.frame_number = latest;
+            frame.timestamp_ns = s->timestamp_ns;
+            frame.publish_ns = s->publish_ns;
+            frame.width = header->width;
+            frame.height = header->height;
+            frame.y = reinterpret_cast<const uint8_t*>(s) + sizeof(FrameTapSlot);
+            frame.uv = frame.y + static_cast<size_t>(header->width) * header->height;
+            frame.slot = s;
+            if (!still_valid(frame)) {
+                torn++;
+                continue;
+            }
+
+            if (last_frame != FRAME_TAP_NO_FRAME && latest > last_frame + 1) {
+                skipped += latest - last_frame - 1;
+            }
+            last_frame = latest;
+            return true;
+        }
+        return false;
+    }
+
+    // Blocks (polling at poll_interval) until a new frame arrives, the producer closes or timeout
+    bool next(Frame& frame, std::chrono::milliseconds timeout = std::chrono::milliseconds(1000),
+              std::chrono::microseconds poll_interval = std::chrono::microseconds(500)) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!try_next(frame)) {
+            if (producer_closed() || std::chrono::steady_clock::now() >= deadline) return false;
+            usleep(static_cast<useconds_t>(poll_interval.count()));
+        }
+        return true;
+    }
+
+    // Pixels read in place are only trustworthy if the producer has not lapped the slot since
+    bool still_valid(const Frame& frame) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return frame.slot->sequence.load(std::memory_order_relaxed) == frame.frame_number * 2 + 2;
+    }
+
+    // Copying alternative for consumers that need the frame for longer than a frame interval
+    bool copy(const Frame& frame, uint8_t* dst) const {
+        std::memcpy(dst, frame.y, header->frame_bytes);
+        return still_valid(frame);
+    }
+
+    uint64_t frames_skipped() const {
+        return skipped;
+    }
+
+    uint64_t torn_reads() const {
+        return torn;
+    }
+
+    uint64_t frame_bytes() const {
+        return header ? header->frame_bytes : 0;
+    }
+};
@@ -0,0 +1,101 @@
+// latency_histogram.h - Lock-free log-linear (HDR-style) histogram for latency/wait-time metrics
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+// Each power of two is split into SUB_BUCKETS linear buckets, so any recorded value is
+// reported within ~6% of its true value. Recording is a handful of relaxed atomic adds and
+// safe from any number of threads; readers see a slightly torn but monotonic snapshot.
+class LatencyHistogram {
+private:
+    static constexpr int SUB_BITS = 4;
+    static constexpr uint64_t SUB_BUCKETS = 1u << SUB_BITS;
+    static constexpr int MAX_MSB = 40;  // ~18 minutes in ns; larger values land in the last bucket
+    static constexpr size_t BUCKET_COUNT = (MAX_MSB - SUB_BITS + 2) * SUB_BUCKETS;
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max_value{0};
+
+    static int msb(uint64_t value) {
+        return 63 - __builtin_clzll(value);
+    }
+
+    static size_t bucket_index(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        const int top = msb(value);
+        if (top > MAX_MSB) {
+            return BUCKET_COUNT - 1;
+        }
+        const int shift = top - SUB_BITS;
+        const uint64_t sub = (value >> shift) & (SUB_BUCKETS - 1);
+        return static_cast<size_t>((shift + 1) * SUB_BUCKETS + sub);
+    }
+
+    static uint64_t bucket_lower_bound(size_t index) {
+        if (index < 2 * SUB_BUCKETS) {
+            return index;
+        }
+        const uint64_t shift = index / SUB_BUCKETS - 1;
+        const uint64_t sub = index % SUB_BUCKETS;
+        return (SUB_BUCKETS + sub) << shift;
+    }
+
+    static uint64_t bucket_width(size_t index) {
+        return index < 2 * SUB_BUCKETS ? 1 : uint64_t{1} << (index / SUB_BUCKETS - 1);
+    }
+
+public:
+    void record(uint64_t value) {
+        buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t current = max_value.load(std::memory_order_relaxed);
+        while (value > current &&
+               !max_value.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t total_count() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const {
+        return max_value.load(std::memory_order_relaxed);
+    }
+
+    double mean() const {
+        const uint64_t n = total_count();
+        return n ? static_cast<double>(sum.load(std::memory_order_relaxed)) / static_cast<double>(n) : 0.0;
+    }
+
+    // Midpoint of the bucket holding the p-th value (p in [0, 1]), clamped to the observed max
+    uint64_t percentile(double p) const {
+        const uint64_t n = total_count();
+        if (n == 0) return 0;
+
+        const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(n) + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= target) {
+                return std::min(bucket_lower_bound(i) + bucket_width(i) / 2, max());
+            }
+        }
+        return max();
+    }
+
+    void reset() {
+        for (auto& bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        max_value.store(0, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,202 @@
+// live_egress.h - Optional SRT/RIST/UDP MPEG-TS egress that reuses a recorder's encoders
+#pragma once
+
+#include "third_party/obs/include/obs.h"
+#include "third_party/obs/include/util/platform.h"
+#include "third_party/json.hpp"
+#include "latency_histogram.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <atomic>
+
+using json = nlohmann::json;
+
+struct EgressConfig {
+    std::string url;          // srt://, rist:// or udp:// (udp is for local test receivers)
+    int latency_ms = 200;     // SRT latency / RIST minimum buffer
+    int buffer_ms = 1000;     // SRT send buffer / RIST maximum buffer / UDP socket buffer, as time at bitrate
+
+    // Reads the optional "egress" object of a start request; false with error set if invalid
+    static bool parse(const json& body, EgressConfig& config, std::string& error) {
+        const json& egress = body.at("egress");
+        if (!egress.is_object() || !egress.contains("url") || !egress["url"].is_string()) {
+            error = "egress.url is required";
+            return false;
+        }
+
+        // value() throws on a wrong type, which would surface as a 500
+        for (const char* key : {"latency_ms", "buffer_ms"}) {
+            if (egress.contains(key) && !egress[key].is_number_integer()) {
+                error = std::string("egress.") + key + " must be an integer";
+                return false;
+            }
+        }
+
+        config.url = egress["url"].get<std::string>();
+        config.latency_ms = egress.value("latency_ms", config.latency_ms);
+        config.buffer_ms = egress.value("buffer_ms", config.buffer_ms);
+
+        if (config.url.rfind("srt://", 0) != 0 && config.url.rfind("rist://", 0) != 0 &&
+            config.url.rfind("udp://", 0) != 0) {
+            error = "egress.url must be srt://, rist:// or udp://";
+            return false;
+        }
+        if (config.latency_ms < 20 || config.latency_ms > 8000 || config.buffer_ms < config.latency_ms) {
+            error = "egress.latency_ms must be 20-8000 and buffer_ms >= latency_ms";
+            return false;
+        }
+        return true;
+    }
+};
+
+// A second output on the recorder's existing video/audio encoders: OBS fans the same
+// packets out to the MP4 muxer and to ffmpeg_mpegts_muxer, so there is no second encode.
+class LiveEgress {
+private:
+    std::string stream_id;
+    EgressConfig config;
+    obs_service_t* service = nullptr;
+    obs_output_t* output = nullptr;
+    std::chrono::steady_clock::time_point start_time;
+
+    // Frame tick (cts) -> encoded packet handed to the muxers
+    LatencyHistogram glass_to_encoder_us;
+    std::atomic<uint64_t> video_packets{0};
+
+    static void append_param(std::string& url, const std::string& key, const std::string& value) {
+        if (url.find(key + "=") != std::string::npos) return; // caller's explicit value wins
+        url += (url.find('?') == std::string::npos ? "?" : "&") + key + "=" + value;
+    }
+
+    std::string build_url(int bitrate_kbps) const {
+        std::string url = config.url;
+        const long long buffer_bytes = static_cast<long long>(bitrate_kbps) * 1000 / 8 * config.buffer_ms / 1000;
+
+        if (url.rfind("srt://", 0) == 0) {
+            append_param(url, "latency", std::to_string(config.latency_ms * 1000)); // microseconds
+            append_param(url, "sndbuf", std::to_string(buffer_bytes));
+        } else if (url.rfind("rist://", 0) == 0) {
+            append_param(url, "buffer-min", std::to_string(config.latency_ms));
+            append_param(url, "buffer-max", std::to_string(config.buffer_ms));
+        } else {
+            append_param(url, "pkt_size", "1316");
+            append_param(url, "buffer_size", std::to_string(buffer_bytes));
+        }
+        return url;
+    }
+
+    static void packet_callback(obs_output_t*, struct encoder_packet* pkt,
+                                struct encoder_packet_time* pkt_time, void* param) {
+        auto* self = static_cast<LiveEgress*>(param);
+        if (pkt->type != OBS_ENCODER_VIDEO || !pkt_time || !pkt_time->cts) return;
+
+        const uint64_t now = os_gettime_ns();
+        if (now > pkt_time->cts) {
+            self->glass_to_encoder_us.record((now - pkt_time->cts) / 1000);
+        }
+        self->video_packets.fetch_add(1, std::memory_order_relaxed);
+    }
+
+public:
+    LiveEgress(std::string id, EgressConfig cfg) : stream_id(std::move(id)), config(std::move(cfg)) {}
+
+    ~LiveEgress() {
+        stop();
+        if (output) {
+            obs_output_remove_packet_callback(output, packet_callback, this);
+            obs_output_release(output);
+            output = nullptr;
+        }
+        if (service) {
+            obs_service_release(service);
+            service = nullptr;
+        }
+    }
+
+    bool start(obs_encoder_t* video_encoder, obs_encoder_t* audio_encoder, int bitrate_kbps) {
+        obs_data_t* service_settings = obs_data_create();
+        obs_data_set_string(service_settings, "server", build_url(bitrate_kbps).c_str());
+        obs_data_set_string(service_settings, "key", "");
+        service = obs_service_create("rtmp_custom", ("Egress Service " + stream_id).c_str(),
+                                     service_settings, nullptr);
+        obs_data_release(service_settings);
+
+        if (!service) {
+            std::cerr << "Failed to create egress service for stream: " << stream_id << std::endl;
+            return false;
+        }
+
+        output = obs_output_create("ffmpeg_mpegts_muxer", ("Live Egress " + stream_id).c_str(),
+                                   nullptr, nullptr);
+        if (!output) {
+            std::cerr << "Failed to create egress output for stream: " << stream_id << std::endl;
+            return false;
+        }
+
+        obs_output_set_service(output, service);
+        obs_output_set_video_encoder(output, video_encoder);
+        obs_output_set_audio_encoder(output, audio_encoder, 0);
+        // Listener-mode receivers may come and go; keep retrying without touching the recording
+        obs_output_set_reconnect_settings(output, 30, 2);
+        obs_output_add_packet_callback(output, packet_callback, this);
+
+        if (!obs_output_start(output)) {
+            const char* error = obs_output_get_last_error(output);
+            std::cerr << "Failed to start egress for stream " << stream_id
+                      << ": " << (error ? error : "unknown error") << std::endl;
+            return false;
+        }
+
+        start_time = std::chrono::steady_clock::now();
+        std::cout << "Live egress started for stream " << stream_id << ": " << config.url << std::endl;
+        return true;
+    }
+
+    // Waits for the muxer to flush until the deadline (2 s by default), then force-stops
+    void stop(std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2)) {
+        if (output && obs_output_active(output)) {
+            obs_output_stop(output);
+
+            while (obs_output_active(output) && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+
+            if (obs_output_active(output)) {
+                obs_output_force_stop(output);
+            }
+        }
+    }
+
+    json get_status() const {
+        json status;
+        status["url"] = config.url;
+        status["latency_ms"] = config.latency_ms;
+        status["buffer_ms"] = config.buffer_ms;
+
+        if (!output) {
+            status["state"] = "failed";
+            return status;
+        }
+
+        status["state"] = obs_output_reconnecting(output) ? "reconnecting"
+                          : obs_output_active(output) ? "active" : "stopped";
+
+        const uint64_t bytes = obs_output_get_total_bytes(output);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        status["total_bytes"] = bytes;
+        status["average_kbps"] = seconds > 0 ? static_cast<double>(bytes) * 8 / 1000 / seconds : 0.0;
+        status["frames_dropped"] = obs_output_get_frames_dropped(output);
+        status["total_frames"] = obs_output_get_total_frames(output);
+        status["congestion"] = obs_output_get_congestion(const_cast<obs_output_t*>(output));
+        status["connect_time_ms"] = obs_output_get_connect_time_ms(const_cast<obs_output_t*>(output));
+        status["glass_to_encoder_ms"] = {
+            {"p50", glass_to_encoder_us.percentile(0.50) / 1000.0},
+            {"p99", glass_to_encoder_us.percentile(0.99) / 1000.0},
+            {"max", glass_to_encoder_us.max() / 1000.0},
+            {"samples", video_packets.load(std::memory_order_relaxed)}
+        };
+        return status;
+    }
+};
@@ -0,0 +1,266 @@
+// live_preview.h - LL-HLS preview of a running recording, packaged from the MP4 output's encoder packets
+#pragma once
+
+#include "third_party/obs/include/obs.h"
+#include "third_party/obs/include/util/platform.h"
+#include "third_party/httplib.h"
+#include "third_party/json.hpp"
+#include "live_preview_window.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using json = nlohmann::json;
+
+// Nothing is packaged until the first request for the stream's playlist; the packet callback
+// stays attached but returns immediately. Once nobody has asked for anything for idle_timeout
+// the window and its buffers are released again.
+class LivePreview {
+private:
+    // Added to every timestamp so B-frame DTS before the first keyframe never goes negative
+    static constexpr int64_t TIME_OFFSET_S = 10;
+
+    std::string stream_id;
+    obs_encoder_t* video_encoder;       // owned by the StreamRecorder, which outlives this callback
+    obs_encoder_t* audio_encoder;
+    LivePreviewWindow window;
+    uint32_t sample_rate = 48000;
+    uint32_t audio_frame_size = 1024;
+    std::atomic<bool> active{false};
+    std::mutex activation_mutex;        // close() waits out an activation still reading the encoders
+    bool closed = false;
+    std::atomic<uint64_t> last_request_ns{0};
+    std::atomic<uint64_t> activations{0};
+    std::atomic<uint64_t> playlist_requests{0};
+    std::atomic<uint64_t> part_requests{0};
+    std::atomic<uint64_t> segment_requests{0};
+
+    static int64_t rescale(int64_t t, int32_t num, int32_t den, int64_t timescale) {
+        return den > 0 ? t * num * timescale / den : t;
+    }
+
+    // Runs on the output thread next to trace_packet_callback; packets are already interleaved
+    static void packet_callback(obs_output_t*, struct encoder_packet* pkt,
+                                struct encoder_packet_time* pkt_time, void* param) {
+        auto* self = static_cast<LivePreview*>(param);
+        if (!self->active.load(std::memory_order_relaxed)) return;
+
+        // Load the request stamp before reading the clock: a request landing in between would
+        // otherwise put last_request_ns ahead of now
+        const uint64_t last_request = self->last_request_ns.load(std::memory_order_relaxed);
+        const uint64_t now = os_gettime_ns();
+        const auto idle_ns = static_cast<int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(self->window.get_config().idle_timeout).count());
+        if (static_cast<int64_t>(now - last_request) > idle_ns) {
+            self->active = false;
+            self->window.reset();
+            std::cout << "Live preview idle, released window for stream " << self->stream_id << std::endl;
+            return;
+        }
+
+        if (pkt->type == OBS_ENCODER_VIDEO) {
+            const int64_t offset = TIME_OFFSET_S * CmafMuxer::VIDEO_TIMESCALE;
+            self->window.push_video(pkt->data, pkt->size,
+                                    rescale(pkt->dts, pkt->timebase_num, pkt->timebase_den, CmafMuxer::VIDEO_TIMESCALE) + offset,
+                                    rescale(pkt->pts, pkt->timebase_num, pkt->timebase_den, CmafMuxer::VIDEO_TIMESCALE) + offset,
+                                    pkt->keyframe, pkt_time ? pkt_time->cts : now, now);
+        } else if (pkt->track_idx == 0) {
+            const int64_t offset = TIME_OFFSET_S * static_cast<int64_t>(self->sample_rate);
+            self->window.push_audio(pkt->data, pkt->size,
+                                    rescale(pkt->dts, pkt->timebase_num, pkt->timebase_den, self->sample_rate) + offset,
+                                    self->audio_frame_size);
+        }
+    }
+
+    // First viewer: the encoders are open by now, so their headers are available
+    PreviewResult ensure_active() {
+        last_request_ns = os_gettime_ns();
+        if (active) return PreviewResult::OK;
+
+        std::lock_guard<std::mutex> lock(activation_mutex);
+        if (closed) return PreviewResult::CLOSED;
+
+        if (!window.is_configured()) {
+            uint8_t* header = nullptr;
+            size_t header_size = 0;
+            uint8_t* audio_config = nullptr;
+            size_t audio_config_size = 0;
+            if (!obs_encoder_get_extra_data(video_encoder, &header, &header_size)) return PreviewResult::TIMEOUT;
+            if (audio_encoder && obs_encoder_get_extra_data(audio_encoder, &audio_config, &audio_config_size)) {
+                sample_rate = obs_encoder_get_sample_rate(audio_encoder);
+                if (const size_t frame_size = obs_encoder_get_frame_size(audio_encoder)) {
+                    audio_frame_size = static_cast<uint32_t>(frame_size);
+                }
+            }
+            if (!window.configure(header, header_size, obs_encoder_get_width(video_encoder),
+                                  obs_encoder_get_height(video_encoder), audio_config, audio_config_size,
+                                  sample_rate)) {
+                std::cerr << "Live preview: no usable H.264 header for stream " << stream_id << std::endl;
+                return PreviewResult::TIMEOUT;
+            }
+        }
+
+        if (!active.exchange(true)) {
+            activations++;
+            std::cout << "Live preview started for stream " << stream_id << std::endl;
+        }
+        return PreviewResult::OK;
+    }
+
+    static bool parse_part_name(const std::string& file, unsigned long long& msn, unsigned& index) {
+        int consumed = 0;
+        return std::sscanf(file.c_str(), "part_%llu_%u.m4s%n", &msn, &index, &consumed) == 2 &&
+               static_cast<size_t>(consumed) == file.size();
+    }
+
+    static bool parse_segment_name(const std::string& file, unsigned long long& msn) {
+        int consumed = 0;
+        return std::sscanf(file.c_str(), "seg_%llu.m4s%n", &msn, &consumed) == 1 &&
+               static_cast<size_t>(consumed) == file.size();
+    }
+
+    // Every viewer streams straight out of the shared part buffers; nothing is copied per request
+    static void send_buffers(httplib::Response& res, std::vector<PreviewBuffer> buffers, const char* content_type) {
+        size_t total = 0;
+        for (const auto& b : buffers) total += b->size();
+        res.set_content_provider(total, content_type,
+            [buffers = std::move(buffers)](size_t offset, size_t length, httplib::DataSink& sink) {
+                for (const auto& b : buffers) {
+                    if (offset >= b->size()) {
+                        offset -= b->size();
+                        continue;
+                    }
+                    const size_t n = std::min(length, b->size() - offset);
+                    if (!sink.write(reinterpret_cast<const char*>(b->data()) + offset, n)) return false;
+                    length -= n;
+                    offset = 0;
+                    if (length == 0) break;
+                }
+                return true;
+            });
+    }
+
+    void send_error(httplib::Response& res, PreviewResult result, const std::string& file) const {
+        json error_response;
+        error_response["stream_id"] = stream_id;
+        error_response["file"] = file;
+        switch (result) {
+            case PreviewResult::BAD_REQUEST:
+                error_response["error"] = "Requested media sequence is too far ahead";
+                res.status = 400;
+                break;
+            case PreviewResult::TIMEOUT:
+            case PreviewResult::BUSY:
+                error_response["error"] = result == PreviewResult::BUSY ? "Too many blocked preview requests"
+                                                                         : "Live preview not ready";
+                res.status = 503;
+                res.set_header("Retry-After", "1");
+                break;
+            case PreviewResult::CLOSED:
+                error_response["error"] = "Stream is not recording";
+                res.status = 404;
+                break;
+            default:
+                error_response["error"] = "Not in the live window";
+                res.status = 404;
+                break;
+        }
+        res.set_header("Cache-Control", "no-cache");
+        res.set_content(error_response.dump(), "application/json");
+    }
+
+public:
+    LivePreview(std::string id, obs_encoder_t* venc, obs_encoder_t* aenc,
+                LivePreviewConfig cfg = LivePreviewConfig())
+        : stream_id(std::move(id)), video_encoder(venc), audio_encoder(aenc), window(cfg) {}
+
+    // Registered before obs_output_start(); removed before the output is released
+    void attach(obs_output_t* output) {
+        obs_output_add_packet_callback(output, packet_callback, this);
+    }
+
+    void detach(obs_output_t* output) {
+        obs_output_remove_packet_callback(output, packet_callback, this);
+    }
+
+    // Recording is stopping; after this returns the encoders are never touched again
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(activation_mutex);
+            closed = true;
+        }
+        active = false;
+        window.close();
+    }
+
+    // GET .../live/{file}: index.m3u8 (with optional _HLS_msn/_HLS_part blocking reload),
+    // init.mp4, part_{msn}_{n}.m4s and seg_{msn}.m4s
+    void serve(const std::string& file, const httplib::Request& req, httplib::Response& res) {
+        // LL-HLS: hold a blocking request at most three target durations
+        const auto deadline = LivePreviewWindow::Clock::now() +
+                              std::chrono::seconds(3 * window.get_config().segment_target_s);
+
+        const PreviewResult activation = ensure_active();
+        if (activation != PreviewResult::OK) {
+            send_error(res, activation, file);
+            return;
+        }
+
+        unsigned long long msn = 0;
+        unsigned index = 0;
+        if (file == "index.m3u8") {
+            playlist_requests.fetch_add(1, std::memory_order_relaxed);
+            const int64_t want_msn = req.has_param("_HLS_msn") ? std::atoll(req.get_param_value("_HLS_msn").c_str()) : -1;
+            const int64_t want_part = req.has_param("_HLS_part") ? std::atoll(req.get_param_value("_HLS_part").c_str()) : -1;
+
+            std::shared_ptr<const std::string> playlist;
+            const PreviewResult result = window.get_playlist(want_msn, want_part, deadline, playlist);
+            if (result != PreviewResult::OK) {
+                send_error(res, result, file);
+                return;
+            }
+            res.set_header("Cache-Control", "no-cache");
+            res.set_content(*playlist, "application/vnd.apple.mpegurl");
+        } else if (file == "init.mp4") {
+            send_buffers(res, {window.get_init_segment()}, "video/mp4");
+        } else if (parse_part_name(file, msn, index)) {
+            part_requests.fetch_add(1, std::memory_order_relaxed);
+            PreviewBuffer part;
+            const PreviewResult result = window.get_part(msn, index, deadline, part);
+            if (result != PreviewResult::OK) {
+                send_error(res, result, file);
+                return;
+            }
+            res.set_header("Cache-Control", "max-age=60");
+            send_buffers(res, {std::move(part)}, "video/mp4");
+        } else if (parse_segment_name(file, msn)) {
+            segment_requests.fetch_add(1, std::memory_order_relaxed);
+            std::vector<PreviewBuffer> parts;
+            const PreviewResult result = window.get_segment(msn, parts);
+            if (result != PreviewResult::OK) {
+                send_error(res, result, file);
+                return;
+            }
+            res.set_header("Cache-Control", "max-age=60");
+            send_buffers(res, std::move(parts), "video/mp4");
+        } else {
+            send_error(res, PreviewResult::NOT_FOUND, file);
+        }
+    }
+
+    json get_status() const {
+        json status = window.get_status();
+        status["active"] = active.load();
+        status["activations"] = activations.load();
+        status["playlist_requests"] = playlist_requests.load();
+        status["part_requests"] = part_requests.load();
+        status["segment_requests"] = segment_requests.load();
+        status["url"] = "/v1/stream/" + stream_id + "/live/index.m3u8";
+        return status;
+    }
+};
@@ -0,0 +1,510 @@
+// live_preview_window.h - In-memory LL-HLS window: CMAF parts/segments in pooled buffers plus the playlist.
+// No OBS dependency: the recorder feeds encoder packets in through LivePreview, and every HTTP
+// viewer is served from the same immutable buffers, so memory does not grow with the audience.
+#pragma once
+
+#include "third_party/json.hpp"
+#include "cmaf_muxer.h"
+#include "latency_histogram.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+using PreviewBuffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+struct LivePreviewConfig {
+    uint32_t part_target_ms = 334;      // 10 frames at 30 fps
+    uint32_t segment_target_s = 2;      // segments are cut on keyframes (x264 keyint_sec)
+    uint32_t window_s = 8;              // complete segments are evicted once older than this
+    size_t max_bytes = 24u << 20;       // hard cap on parts held per stream
+    std::chrono::seconds idle_timeout{30};  // no viewer requests for this long: stop packaging
+};
+
+// Part buffers go back to a small free list when the window and every viewer are done with
+// them, so steady-state packaging reuses the same few allocations
+class PreviewBufferPool {
+private:
+    struct Shared {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<std::vector<uint8_t>>> free;
+        size_t max_free = 16;
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> reuses{0};
+        std::atomic<size_t> outstanding{0};
+    };
+    std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+
+public:
+    std::shared_ptr<std::vector<uint8_t>> acquire() {
+        std::unique_ptr<std::vector<uint8_t>> buffer;
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (!shared->free.empty()) {
+                buffer = std::move(shared->free.back());
+                shared->free.pop_back();
+            }
+        }
+        if (buffer) {
+            shared->reuses.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            buffer = std::make_unique<std::vector<uint8_t>>();
+            shared->allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        shared->outstanding.fetch_add(1, std::memory_order_relaxed);
+
+        // A viewer still sending a part may hold the last reference after the pool is gone
+        std::weak_ptr<Shared> owner = shared;
+        return std::shared_ptr<std::vector<uint8_t>>(buffer.release(), [owner](std::vector<uint8_t>* released) {
+            std::unique_ptr<std::vector<uint8_t>> recycled(released);
+            if (auto pool = owner.lock()) {
+                pool->outstanding.fetch_sub(1, std::memory_order_relaxed);
+                recycled->clear();
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                if (pool->free.size() < pool->max_free) pool->free.push_back(std::move(recycled));
+            }
+        });
+    }
+
+    // Frees the idle buffers, keeps the ones still referenced
+    void trim() {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        shared->free.clear();
+    }
+
+    json get_status() const {
+        size_t free_buffers, free_bytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            free_buffers = shared->free.size();
+            for (const auto& b : shared->free) free_bytes += b->capacity();
+        }
+        return {
+            {"allocations", shared->allocations.load(std::memory_order_relaxed)},
+            {"reuses", shared->reuses.load(std::memory_order_relaxed)},
+            {"outstanding", shared->outstanding.load(std::memory_order_relaxed)},
+            {"free_buffers", free_buffers},
+            {"free_bytes", free_bytes}
+        };
+    }
+};
+
+enum class PreviewResult {
+    OK,
+    NOT_FOUND,      // evicted, or not the next part to be published
+    BAD_REQUEST,    // _HLS_msn/_HLS_part too far ahead
+    TIMEOUT,        // blocking request not satisfied in time
+    BUSY,           // too many requests already blocked
+    CLOSED          // recording stopped
+};
+
+class LivePreviewWindow {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Blocked playlist/part requests each hold an HTTP worker; cap them across all streams
+    static constexpr size_t MAX_BLOCKED_REQUESTS = 32;
+
+private:
+    struct Part {
+        PreviewBuffer data;
+        double duration = 0.0;
+        bool independent = false;
+    };
+
+    struct Segment {
+        uint64_t msn = 0;
+        std::vector<Part> parts;
+        double duration = 0.0;
+        size_t bytes = 0;
+        bool complete = false;
+        Clock::time_point completed_at;
+    };
+
+    static inline std::atomic<size_t> blocked_requests{0};
+
+    LivePreviewConfig config;
+    PreviewBufferPool pool;
+    CmafMuxer muxer;
+    PreviewBuffer init;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    bool closed = false;
+    std::deque<Segment> segments;       // back() is the open segment while segment_open
+    bool segment_open = false;
+    uint64_t next_msn = 0;
+    uint32_t fragment_sequence = 1;
+    uint32_t target_duration;
+    size_t held_bytes = 0;
+    std::shared_ptr<const std::string> playlist;
+
+    // Staging for the part being built
+    CmafTrackRun video_run;
+    CmafTrackRun audio_run;
+    int64_t last_video_dts = 0;
+    uint32_t last_frame_ticks = 0;
+    uint64_t staged_video_ticks = 0;
+    bool part_independent = false;
+    uint64_t part_capture_ns = 0;
+
+    uint64_t parts_published = 0;
+    uint64_t evicted_by_age = 0;
+    uint64_t evicted_by_size = 0;
+    uint64_t overflow_resets = 0;
+    uint64_t blocked_rejected = 0;
+    LatencyHistogram capture_to_part_us;
+
+    uint64_t part_target_ticks() const {
+        return static_cast<uint64_t>(config.part_target_ms) * CmafMuxer::VIDEO_TIMESCALE / 1000;
+    }
+
+    double part_hold_back() const {
+        return 3.0 * config.part_target_ms / 1000.0;
+    }
+
+    void drop_all_locked() {
+        segments.clear();
+        segment_open = false;
+        held_bytes = 0;
+        playlist.reset();
+        video_run.clear();
+        audio_run.clear();
+        staged_video_ticks = 0;
+    }
+
+    void open_segment_locked() {
+        Segment segment;
+        segment.msn = next_msn++;
+        segments.push_back(std::move(segment));
+        segment_open = true;
+    }
+
+    void evict_locked() {
+        const auto now = Clock::now();
+        while (segments.size() > 1 && segments.front().complete &&
+               now - segments.front().completed_at > std::chrono::seconds(config.window_s)) {
+            held_bytes -= segments.front().bytes;
+            segments.pop_front();
+            evicted_by_age++;
+        }
+        while (held_bytes > config.max_bytes && segments.size() > 1) {
+            held_bytes -= segments.front().bytes;
+            segments.pop_front();
+            evicted_by_size++;
+        }
+        if (held_bytes > config.max_bytes) {
+            // A single segment over the cap (bitrate far above what max_bytes was sized for):
+            // start over from the next keyframe rather than grow
+            drop_all_locked();
+            overflow_resets++;
+        }
+    }
+
+    void publish_part_locked(uint64_t now_ns) {
+        auto buffer = pool.acquire();
+        CmafMuxer::write_fragment(fragment_sequence++, video_run, audio_run, *buffer);
+
+        Segment& segment = segments.back();
+        Part part;
+        part.duration = static_cast<double>(staged_video_ticks) / CmafMuxer::VIDEO_TIMESCALE;
+        part.independent = part_independent;
+        segment.bytes += buffer->size();
+        held_bytes += buffer->size();
+        part.data = std::move(buffer);
+        segment.duration += part.duration;
+        segment.parts.push_back(std::move(part));
+
+        if (now_ns > part_capture_ns) capture_to_part_us.record((now_ns - part_capture_ns) / 1000);
+        parts_published++;
+        video_run.clear();
+        audio_run.clear();
+        staged_video_ticks = 0;
+
+        evict_locked();
+        rebuild_playlist_locked();
+        changed.notify_all();
+    }
+
+    void complete_segment_locked() {
+        Segment& segment = segments.back();
+        segment.complete = true;
+        segment.completed_at = Clock::now();
+        target_duration = std::max(target_duration, static_cast<uint32_t>(std::lround(segment.duration)));
+        segment_open = false;
+    }
+
+    void rebuild_playlist_locked() {
+        if (segments.empty() || segments.front().parts.empty()) {
+            playlist.reset();
+            return;
+        }
+
+        auto text = std::make_shared<std::string>();
+        text->reserve(256 + segments.size() * 64 + 48 * (segments.back().parts.size() + 16));
+        char line[160];
+        snprintf(line, sizeof(line), "#EXTM3U\n#EXT-X-VERSION:6\n#EXT-X-TARGETDURATION:%u\n#EXT-X-PART-INF:PART-TARGET=%.3f\n",
+                 target_duration, config.part_target_ms / 1000.0);
+        *text += line;
+        snprintf(line, sizeof(line), "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\n#EXT-X-MEDIA-SEQUENCE:%llu\n",
+                 part_hold_back(), static_cast<unsigned long long>(segments.front().msn));
+        *text += line;
+        *text += "#EXT-X-MAP:URI=\"init.mp4\"\n";
+
+        // Parts are only advertised within three target durations of the live edge
+        double from_edge = 0.0;
+        size_t first_with_parts = segments.size();
+        while (first_with_parts > 0 && from_edge < 3.0 * target_duration) {
+            from_edge += segments[--first_with_parts].duration;
+        }
+
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const Segment& segment = segments[i];
+            const auto msn = static_cast<unsigned long long>(segment.msn);
+            if (i >= first_with_parts) {
+                for (size_t p = 0; p < segment.parts.size(); ++p) {
+                    snprintf(line, sizeof(line), "#EXT-X-PART:DURATION=%.5f,URI=\"part_%llu_%zu.m4s\"%s\n",
+                             segment.parts[p].duration, msn, p,
+                             segment.parts[p].independent ? ",INDEPENDENT=YES" : "");
+                    *text += line;
+                }
+            }
+            if (segment.complete) {
+                snprintf(line, sizeof(line), "#EXTINF:%.5f,\nseg_%llu.m4s\n", segment.duration, msn);
+                *text += line;
+            }
+        }
+
+        const Segment& edge = segments.back();
+        snprintf(line, sizeof(line), "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part_%llu_%zu.m4s\"\n",
+                 static_cast<unsigned long long>(edge.complete ? edge.msn + 1 : edge.msn),
+                 edge.complete ? size_t{0} : edge.parts.size());
+        *text += line;
+        playlist = std::move(text);
+    }
+
+    const Segment* find_locked(uint64_t msn) const {
+        if (segments.empty() || msn < segments.front().msn || msn > segments.back().msn) return nullptr;
+        return &segments[static_cast<size_t>(msn - segments.front().msn)];
+    }
+
+    // Part (msn, index) is published, or will be next
+    bool part_exists_locked(uint64_t msn, uint32_t index) const {
+        const Segment* segment = find_locked(msn);
+        return segment && index < segment->parts.size();
+    }
+
+    bool part_is_next_locked(uint64_t msn, uint32_t index) const {
+        if (segments.empty()) return !segment_open && index == 0;
+        const Segment& edge = segments.back();
+        return edge.complete ? (msn == edge.msn + 1 && index == 0) : (msn == edge.msn && index == edge.parts.size());
+    }
+
+    template <typename Ready>
+    PreviewResult wait_locked(std::unique_lock<std::mutex>& lock, Clock::time_point deadline, Ready ready) {
+        if (closed) return PreviewResult::CLOSED;
+        if (ready()) return PreviewResult::OK;
+        if (blocked_requests.fetch_add(1) >= MAX_BLOCKED_REQUESTS) {
+            blocked_requests.fetch_sub(1);
+            blocked_rejected++;
+            return PreviewResult::BUSY;
+        }
+        const bool satisfied = changed.wait_until(lock, deadline, [&] { return closed || ready(); });
+        blocked_requests.fetch_sub(1);
+        if (closed) return PreviewResult::CLOSED;
+        return satisfied ? PreviewResult::OK : PreviewResult::TIMEOUT;
+    }
+
+public:
+    explicit LivePreviewWindow(LivePreviewConfig cfg = LivePreviewConfig())
+        : config(cfg), target_duration(cfg.segment_target_s) {}
+
+    // Builds the init segment; header is the H.264 encoder's Annex B extra data, audio_config
+    // the AAC AudioSpecificConfig (may be empty for a video-only preview)
+    bool configure(const uint8_t* header, size_t header_size, uint32_t width, uint32_t height,
+                   const uint8_t* audio_config, size_t audio_config_size, uint32_t sample_rate) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (init) return true;
+        if (!muxer.set_video_config(header, header_size, width, height)) return false;
+        if (audio_config_size > 0) muxer.set_audio_config(audio_config, audio_config_size, sample_rate);
+
+        auto buffer = std::make_shared<std::vector<uint8_t>>();
+        muxer.write_init_segment(*buffer);
+        init = std::move(buffer);
+        return true;
+    }
+
+    bool is_configured() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return init != nullptr;
+    }
+
+    // Packets arrive in output (interleaved) order. Video times are in 90 kHz ticks, audio in
+    // sample-rate ticks, both offset so they are never negative.
+    void push_video(const uint8_t* data, size_t size, int64_t dts, int64_t pts, bool keyframe,
+                    uint64_t capture_ns, uint64_t now_ns) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed || !init) return;
+
+        if (!video_run.samples.empty()) {
+            // The previous frame's duration is only known now
+            CmafSample& last = video_run.samples.back();
+            last.duration = static_cast<uint32_t>(std::max<int64_t>(dts - last_video_dts, 1));
+            last_frame_ticks = last.duration;
+            staged_video_ticks += last.duration;
+
+            if (keyframe) {
+                publish_part_locked(now_ns);
+                if (segment_open) complete_segment_locked();
+            } else if (staged_video_ticks + last_frame_ticks > part_target_ticks()) {
+                publish_part_locked(now_ns);
+            }
+        }
+
+        if (!segment_open) {
+            // Segments (and a fresh window) start on a keyframe
+            if (!keyframe) return;
+            open_segment_locked();
+        }
+
+        if (video_run.samples.empty()) {
+            video_run.base_decode_time = static_cast<uint64_t>(dts);
+            part_independent = keyframe;
+            part_capture_ns = capture_ns;
+        }
+        CmafSample sample;
+        sample.offset = static_cast<uint32_t>(video_run.payload.size());
+        sample.size = CmafMuxer::append_avcc(data, size, video_run.payload);
+        sample.composition_offset = static_cast<int32_t>(pts - dts);
+        sample.sync = keyframe;
+        video_run.samples.push_back(sample);
+        last_video_dts = dts;
+    }
+
+    void push_audio(const uint8_t* data, size_t size, int64_t dts, uint32_t duration) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed || !segment_open || !muxer.has_audio()) return;
+
+        if (audio_run.samples.empty()) audio_run.base_decode_time = static_cast<uint64_t>(dts);
+        CmafSample sample;
+        sample.offset = static_cast<uint32_t>(audio_run.payload.size());
+        sample.size = static_cast<uint32_t>(size);
+        sample.duration = duration;
+        sample.sync = true;
+        audio_run.payload.insert(audio_run.payload.end(), data, data + size);
+        audio_run.samples.push_back(sample);
+    }
+
+    // Nobody is watching: free the window and the pooled buffers; the next viewer restarts at a keyframe
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        drop_all_locked();
+        pool.trim();
+    }
+
+    // Recording stopped; wakes blocked viewers
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        changed.notify_all();
+    }
+
+    PreviewBuffer get_init_segment() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return init;
+    }
+
+    // Playlist, blocking until part (msn, part) exists when msn >= 0 (LL-HLS blocking reload;
+    // part < 0 waits for the whole segment). Without msn it waits only for the first part.
+    PreviewResult get_playlist(int64_t msn, int64_t part, Clock::time_point deadline,
+                               std::shared_ptr<const std::string>& out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (msn >= 0 && !segments.empty() && static_cast<uint64_t>(msn) > segments.back().msn + 1) {
+            return PreviewResult::BAD_REQUEST;
+        }
+
+        const PreviewResult result = wait_locked(lock, deadline, [&] {
+            if (!playlist) return false;
+            if (msn < 0) return true;
+            const uint64_t m = static_cast<uint64_t>(msn);
+            if (m < segments.back().msn) return true;
+            if (m > segments.back().msn) return false;
+            const Segment& segment = segments.back();
+            return part < 0 ? segment.complete : static_cast<size_t>(part) < segment.parts.size() || segment.complete;
+        });
+        if (result == PreviewResult::OK) out = playlist;
+        return result;
+    }
+
+    // A published part, or the next one (the playlist's preload hint), which is waited for
+    PreviewResult get_part(uint64_t msn, uint32_t index, Clock::time_point deadline, PreviewBuffer& out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!part_exists_locked(msn, index) && !part_is_next_locked(msn, index)) {
+            return PreviewResult::NOT_FOUND;
+        }
+
+        const PreviewResult result = wait_locked(lock, deadline, [&] {
+            // A reset in the meantime means this part will never appear
+            return part_exists_locked(msn, index) || segments.empty() || segments.back().msn > msn;
+        });
+        if (result != PreviewResult::OK) return result;
+        if (!part_exists_locked(msn, index)) return PreviewResult::NOT_FOUND;
+        out = find_locked(msn)->parts[index].data;
+        return PreviewResult::OK;
+    }
+
+    // Parts of a complete segment; concatenated they form the full segment
+    PreviewResult get_segment(uint64_t msn, std::vector<PreviewBuffer>& out) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        const Segment* segment = find_locked(msn);
+        if (!segment || !segment->complete) return PreviewResult::NOT_FOUND;
+        for (const Part& part : segment->parts) out.push_back(part.data);
+        return PreviewResult::OK;
+    }
+
+    size_t get_held_bytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return held_bytes;
+    }
+
+    const LivePreviewConfig& get_config() const {
+        return config;
+    }
+
+    json get_status() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        json status;
+        status["segments"] = segments.size();
+        status["media_sequence"] = segments.empty() ? 0 : segments.front().msn;
+        status["parts_published"] = parts_published;
+        status["held_bytes"] = held_bytes;
+        status["max_bytes"] = config.max_bytes;
+        status["evicted_by_age"] = evicted_by_age;
+        status["evicted_by_size"] = evicted_by_size;
+        status["overflow_resets"] = overflow_resets;
+        status["blocked_requests_rejected"] = blocked_rejected;
+        status["buffer_pool"] = pool.get_status();
+        status["part_target_ms"] = config.part_target_ms;
+        status["part_hold_back_ms"] = part_hold_back() * 1000.0;
+        // What a player at PART-HOLD-BACK sees: capture-to-publish of a part's first frame plus the hold back
+        status["capture_to_part_ms"] = {
+            {"p50", capture_to_part_us.percentile(0.50) / 1000.0},
+            {"p99", capture_to_part_us.percentile(0.99) / 1000.0},
+            {"max", capture_to_part_us.max() / 1000.0}
+        };
+        status["estimated_latency_ms"] = capture_to_part_us.percentile(0.50) / 1000.0 + part_hold_back() * 1000.0;
+        return status;
+    }
+};
@@ -6,10 +6,22 @@
 #include <string>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
 #include <map>
 #include <atomic>
 #include "third_party/httplib.h"
 #include "third_party/json.hpp"
+#include "encoder_calibration.h"
+#include "request_executor.h"
+#include "route_trie.h"
+#include "live_egress.h"
+#include "frame_tap.h"
+#include "pipeline_trace.h"
+#include "core_scheduler.h"
+#include "capture_target.h"
+#include "shutdown_coordinator.h"
+#include "live_preview.h"
+#include "third_party/obs/include/util/platform.h"
 #include <utility>
 #include <vector>
 #include <CoreGraphics/CoreGraphics.h>
@@ -17,14 +29,6 @@
 
 using json = nlohmann::json;
 
-// Global flag for graceful shutdown
-std::atomic<bool> should_stop{false};
-
-void signal_handler(int signal) {
-    std::cout << "\nReceived signal " << signal << ", stopping server..." << std::endl;
-    should_stop = true;
-}
-
 enum class StreamState {
     IDLE,
     RECORDING,
@@ -50,6 +54,11 @@ private:
 
     OBSCore() = default;
 
+    // Graphics thread, right after a mix (main or view) has been rendered for the current frame time
+    static void main_rendered_callback(void* param) {
+        static_cast<MixComposites*>(param)->on_rendered(obs_get_video_frame_time(), os_gettime_ns());
+    }
+
     static bool load_plugins() {
         const std::string base_path = "/Applications/3CLogicScreenRecorder.app/Contents/PlugIns";
         const std::vector<std::string> plugins = {
@@ -102,6 +111,7 @@ public:
 
         // Load plugins
         load_plugins();
+        CalibrationPattern::register_source();
 
         // Get M1 MacBook Pro native display info
         CGDirectDisplayID main_display = CGMainDisplayID();
@@ -163,6 +173,9 @@ public:
             return false;
         }
 
+        MixComposites::getInstance()->add_mix(obs_get_video());
+        obs_add_main_rendered_callback(main_rendered_callback, MixComposites::getInstance());
+
         initialized = true;
         std::cout << "OBS Core initialized successfully!" << std::endl;
         return true;
@@ -171,6 +184,8 @@ public:
     void shutdown() {
         std::lock_guard<std::mutex> lock(core_mutex);
         if (initialized) {
+            obs_remove_main_rendered_callback(main_rendered_callback, MixComposites::getInstance());
+            MixComposites::getInstance()->remove_mix(obs_get_video());
             obs_shutdown();
             initialized = false;
             std::cout << "OBS Core shutdown complete" << std::endl;
@@ -181,11 +196,68 @@ public:
         return initialized;
     }
 
+    // Render-loop health shared by every stream: late ticks and frames the encoders never got
+    json getRenderStats() const {
+        json stats;
+        stats["average_frame_time_ms"] = obs_get_average_frame_time_ns() / 1e6;
+        stats["frame_interval_ms"] = obs_get_frame_interval_ns() / 1e6;
+        stats["rendered_frames"] = obs_get_total_frames();
+        stats["lagged_frames"] = obs_get_lagged_frames();
+        if (video_t* video = obs_get_video()) {
+            stats["output_frames"] = video_output_get_total_frames(video);
+            stats["skipped_frames"] = video_output_get_skipped_frames(video);
+        }
+        return stats;
+    }
+
     void getVideoInfo(size_t& width, size_t& height) const {
         width = pixel_width;
         height = pixel_height;
     }
 
+    // Pixel size of an active display; index 0 is the main display, the rest follow in system order
+    static bool getDisplayPixelSize(int index, int& width, int& height) {
+        CGDirectDisplayID displays[16];
+        uint32_t count = 0;
+        if (index < 0 || CGGetActiveDisplayList(16, displays, &count) != kCGErrorSuccess ||
+            static_cast<uint32_t>(index) >= count) {
+            return false;
+        }
+        width = static_cast<int>(CGDisplayPixelsWide(displays[index]));
+        height = static_cast<int>(CGDisplayPixelsHigh(displays[index]));
+        return width > 0 && height > 0;
+    }
+
+    // Pixel size of an on-screen window: its bounds in points times the scale of the display it is on
+    static bool getWindowPixelSize(int window_id, int& width, int& height) {
+        CFArrayRef windows = CGWindowListCopyWindowInfo(kCGWindowListOptionIncludingWindow,
+                                                        static_cast<CGWindowID>(window_id));
+        if (!windows) return false;
+
+        bool found = false;
+        CGRect bounds{};
+        if (CFArrayGetCount(windows) > 0) {
+            auto info = static_cast<CFDictionaryRef>(CFArrayGetValueAtIndex(windows, 0));
+            auto bounds_dict = static_cast<CFDictionaryRef>(CFDictionaryGetValue(info, kCGWindowBounds));
+            found = bounds_dict && CGRectMakeWithDictionaryRepresentation(bounds_dict, &bounds);
+        }
+        CFRelease(windows);
+        if (!found || bounds.size.width <= 0 || bounds.size.height <= 0) return false;
+
+        CGFloat scale = 1.0;
+        CGDirectDisplayID display = 0;
+        uint32_t count = 0;
+        if (CGGetDisplaysWithRect(bounds, 1, &display, &count) == kCGErrorSuccess && count > 0) {
+            const CGRect display_bounds = CGDisplayBounds(display);
+            if (display_bounds.size.width > 0) {
+                scale = static_cast<CGFloat>(CGDisplayPixelsWide(display)) / display_bounds.size.width;
+            }
+        }
+        width = static_cast<int>(bounds.size.width * scale);
+        height = static_cast<int>(bounds.size.height * scale);
+        return width > 0 && height > 0;
+    }
+
     int calculateBitrate() const {
         int pixels = pixel_width * pixel_height;
         int bitrate;
@@ -205,6 +277,12 @@ public:
 
         return bitrate;
     }
+
+    // Cropped canvases keep the full-display bits per pixel, with a floor for small regions
+    int calculateBitrate(size_t width, size_t height) const {
+        const double share = static_cast<double>(width * height) / static_cast<double>(pixel_width * pixel_height);
+        return std::max(2500, static_cast<int>(calculateBitrate() * std::min(share, 1.0)));
+    }
 };
 
 // Initialize static members
@@ -220,13 +298,24 @@ private:
     obs_source_t* desktop_audio = nullptr;
     obs_scene_t* scene = nullptr;
     obs_sceneitem_t* scene_item = nullptr;
+    obs_view_t* view = nullptr;         // private canvas for window/region capture
+    video_t* stream_video = nullptr;    // view's video output, nullptr = main mix
+    CaptureTarget capture;
     obs_output_t* output = nullptr;
     obs_encoder_t* video_encoder = nullptr;
     obs_encoder_t* audio_encoder = nullptr;
+    std::unique_ptr<LiveEgress> egress;
+    std::unique_ptr<FrameTap> frame_tap;
+    std::shared_ptr<LivePreview> preview;   // shared with HTTP viewers still being served
+    PipelineTrace trace;
+    std::shared_ptr<const CompositeRing> composites;    // render completions of the mix we encode
 
     std::string stream_id;
     std::string output_file;
+    EncoderProfile encoder_profile;
+    int video_bitrate = 0;
     std::atomic<StreamState> state{StreamState::IDLE};
+    bool force_stopped = false;     // output missed its stop deadline, the MP4 may be unfinalized
     std::mutex state_mutex;
     std::chrono::steady_clock::time_point start_time;
     std::chrono::steady_clock::time_point pause_time;
@@ -255,15 +344,22 @@ public:
         cleanup();
     }
 
-    bool setup_sources() {
+    bool setup_sources(const CaptureTarget& target = CaptureTarget()) {
+        capture = target;
+
         // Create scene
         scene = obs_scene_create(("Recording Scene " + stream_id).c_str());
         if (!scene) return false;
 
-        // Create screen capture
+        // Create screen capture (type 0 = display, 1 = window)
         obs_data_t* screen_settings = obs_data_create();
         obs_data_set_bool(screen_settings, "show_cursor", true);
-        obs_data_set_int(screen_settings, "display", 0);
+        obs_data_set_int(screen_settings, "display", capture.display);
+        if (capture.type == CaptureTarget::Type::WINDOW) {
+            obs_data_set_int(screen_settings, "type", 1);
+            obs_data_set_int(screen_settings, "window", capture.window_id);
+            obs_data_set_bool(screen_settings, "show_shadow", false);
+        }
 
         screen_capture = obs_source_create("screen_capture",
                                          ("Screen " + stream_id).c_str(),
@@ -277,10 +373,25 @@ public:
 
         // Add to scene
         scene_item = obs_scene_add(scene, screen_capture);
-        if (scene_item) {
+        if (scene_item && capture.type == CaptureTarget::Type::REGION) {
+            // 1:1 pixels, everything outside the rectangle cropped away; the canvas is the rectangle.
+            // Crop against the captured display, which need not be the main one.
+            struct obs_sceneitem_crop crop = {};
+            crop.left = capture.x;
+            crop.top = capture.y;
+            crop.right = std::max(0, capture.display_width - capture.x - capture.width);
+            crop.bottom = std::max(0, capture.display_height - capture.y - capture.height);
+            obs_sceneitem_set_crop(scene_item, &crop);
+            struct vec2 scale = {1.0f, 1.0f};
+            obs_sceneitem_set_scale(scene_item, &scale);
+        } else if (scene_item) {
             struct vec2 bounds{};
             size_t width, height;
             OBSCore::getInstance()->getVideoInfo(width, height);
+            if (capture.uses_own_canvas()) {
+                width = static_cast<size_t>(capture.width);
+                height = static_cast<size_t>(capture.height);
+            }
             bounds.x = static_cast<float>(width);
             bounds.y = static_cast<float>(height);
             obs_sceneitem_set_bounds(scene_item, &bounds);
@@ -306,33 +417,37 @@ public:
         // Allocate output channels
         allocate_channels();
 
-        // Set output sources
+        // Set output sources. Window/region streams render into their own canvas sized to the
+        // captured pixels instead of the full Retina mix.
         obs_source_t* scene_source = obs_scene_get_source(scene);
-        obs_set_output_source(video_channel, scene_source);
+        if (capture.uses_own_canvas()) {
+            if (!create_canvas(scene_source)) {
+                std::cerr << "Failed to create " << capture.width << "x" << capture.height
+                          << " canvas for stream: " << stream_id << std::endl;
+                return false;
+            }
+        } else {
+            obs_set_output_source(video_channel, scene_source);
+        }
         if (mic_capture && audio_channel >= 0) obs_set_output_source(audio_channel, mic_capture);
         if (desktop_audio && desktop_channel >= 0) obs_set_output_source(desktop_channel, desktop_audio);
 
         return true;
     }
 
-    bool setup_encoding() {
-        // Video encoder optimized for M1 MacBook Pro
+    bool setup_encoding(const EncoderProfile& profile) {
+        // Video encoder, preset/threads chosen by the calibrator for the current stream count
         obs_data_t* video_settings = obs_data_create();
-        int bitrate = OBSCore::getInstance()->calculateBitrate();
-
-        obs_data_set_int(video_settings, "bitrate", bitrate);
-        obs_data_set_string(video_settings, "preset", "medium");
-        obs_data_set_string(video_settings, "profile", "high");
-        obs_data_set_string(video_settings, "tune", "film");
-        obs_data_set_int(video_settings, "keyint_sec", 2);
-        obs_data_set_string(video_settings, "rate_control", "CBR");
-        obs_data_set_int(video_settings, "buffer_size", bitrate);
-        obs_data_set_int(video_settings, "crf", 18);
-        obs_data_set_bool(video_settings, "use_bufsize", true);
-        obs_data_set_bool(video_settings, "psycho_aq", true);
-        obs_data_set_int(video_settings, "bf", 2);
-
-        std::cout << "Video bitrate for MP4 (" << stream_id << "): " << bitrate << " kbps" << std::endl;
+        int bitrate = stream_video
+            ? OBSCore::getInstance()->calculateBitrate(capture.width, capture.height)
+            : OBSCore::getInstance()->calculateBitrate();
+
+        video_bitrate = bitrate;
+        encoder_profile = profile;
+        EncoderCalibrator::apply_x264_settings(video_settings, bitrate, encoder_profile);
+
+        std::cout << "Video bitrate for MP4 (" << stream_id << "): " << bitrate << " kbps, preset "
+                  << encoder_profile.preset << ", threads " << encoder_profile.threads << std::endl;
 
         video_encoder = obs_video_encoder_create("obs_x264",
                                                ("Video Encoder " + stream_id).c_str(),
@@ -359,7 +474,8 @@ public:
             return false;
         }
 
-        obs_encoder_set_video(video_encoder, obs_get_video());
+        obs_encoder_set_video(video_encoder, stream_video ? stream_video : obs_get_video());
+        composites = MixComposites::getInstance()->ring_for(stream_video ? stream_video : obs_get_video());
         obs_encoder_set_audio(audio_encoder, obs_get_audio());
 
         return true;
@@ -388,14 +504,29 @@ public:
         // Set encoders
         obs_output_set_video_encoder(output, video_encoder);
         obs_output_set_audio_encoder(output, audio_encoder, 0);
-
-        // Start recording
-        if (!obs_output_start(output)) {
+        obs_output_add_packet_callback(output, trace_packet_callback, this);
+        preview = std::make_shared<LivePreview>(stream_id, video_encoder, audio_encoder);
+        preview->attach(output);
+
+        // Start recording. The encoders open here, so their threads are created under this
+        // stream's core mask and can be re-pinned when other streams come and go.
+        const std::set<int> threads_before = CoreScheduler::list_threads();
+        bool started;
+        std::string thread_tag;
+        {
+            CoreScheduler::ScopedAffinity pin(CoreScheduler::getInstance()->get_assignment(stream_id).cpus);
+            CoreScheduler::ScopedThreadTag tag;
+            thread_tag = tag.name();
+            started = obs_output_start(output);
+        }
+        if (!started) {
             const char* error = obs_output_get_last_error(output);
             std::cerr << "Failed to start recording for stream " << stream_id
                       << ": " << (error ? error : "unknown error") << std::endl;
             return false;
         }
+        CoreScheduler::getInstance()->adopt_threads(stream_id, threads_before, CoreScheduler::list_threads(),
+                                                    thread_tag);
 
         state = StreamState::RECORDING;
         start_time = std::chrono::steady_clock::now();
@@ -405,6 +536,31 @@ public:
         return true;
     }
 
+    // Attaches a live output to the running recording's encoders. Failure leaves the
+    // recording untouched; the error shows up in the egress status.
+    bool start_egress(const EgressConfig& config) {
+        std::lock_guard<std::mutex> lock(state_mutex);
+
+        if (state != StreamState::RECORDING || egress) {
+            return false;
+        }
+
+        egress = std::make_unique<LiveEgress>(stream_id, config);
+        return egress->start(video_encoder, audio_encoder, video_bitrate);
+    }
+
+    // Publishes the raw NV12 mix into shared memory for out-of-process analytics sidecars
+    bool start_frame_tap(const FrameTapConfig& config) {
+        std::lock_guard<std::mutex> lock(state_mutex);
+
+        if (state != StreamState::RECORDING || frame_tap) {
+            return false;
+        }
+
+        frame_tap = std::make_unique<FrameTap>(stream_id, config);
+        return frame_tap->start(stream_video ? stream_video : obs_get_video());
+    }
+
     bool pause_recording() {
         std::lock_guard<std::mutex> lock(state_mutex);
 
@@ -421,25 +577,37 @@ public:
         return true;
     }
 
-    bool stop_recording() {
+    // Gives the MP4 muxer until the deadline (3 s by default) to write the moov atom, then force-stops
+    bool stop_recording(std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3)) {
         std::lock_guard<std::mutex> lock(state_mutex);
 
         if (state != StreamState::RECORDING && state != StreamState::PAUSED) {
             return false;
         }
 
+        if (egress) {
+            egress->stop(deadline);
+        }
+
+        if (frame_tap) {
+            frame_tap->stop();
+        }
+
+        if (preview) {
+            preview->close();
+        }
+
         if (output && obs_output_active(output)) {
             obs_output_stop(output);
 
             // Wait for output to stop
-            int wait_count = 0;
-            while (obs_output_active(output) && wait_count < 30) {
+            while (obs_output_active(output) && std::chrono::steady_clock::now() < deadline) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                wait_count++;
             }
 
             if (obs_output_active(output)) {
                 obs_output_force_stop(output);
+                force_stopped = true;
             }
         }
 
@@ -448,10 +616,27 @@ public:
         return true;
     }
 
+    bool was_force_stopped() const {
+        return force_stopped;
+    }
+
     StreamState get_state() const {
         return state.load();
     }
 
+    json get_trace(bool include_samples) {
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        json result = trace.get_status(elapsed);
+        result["stream_id"] = stream_id;
+        const uint64_t frame_interval = obs_get_frame_interval_ns();
+        result["frame_interval_ms"] = frame_interval / 1e6;
+        result["composite_within_frame_interval"] = trace.composite_within(frame_interval);
+        if (include_samples) {
+            result["samples"] = trace.dump_samples();
+        }
+        return result;
+    }
+
     std::string get_stream_id() const {
         return stream_id;
     }
@@ -460,10 +645,19 @@ public:
         return output_file;
     }
 
+    std::shared_ptr<LivePreview> get_preview() const {
+        return preview;
+    }
+
     json get_status() const {
         json status;
         status["stream_id"] = stream_id;
         status["output_file"] = output_file;
+        status["encoder_preset"] = encoder_profile.preset;
+        status["encoder_threads"] = encoder_profile.threads;
+        status["encoder_cpus"] = CoreScheduler::getInstance()->get_assignment(stream_id).cpus;
+        status["capture"] = capture.to_json();
+        status["video_bitrate_kbps"] = video_bitrate;
 
         switch (state.load()) {
             case StreamState::IDLE:
@@ -486,10 +680,65 @@ public:
             status["duration_seconds"] = duration.count();
         }
 
+        if (egress) {
+            status["egress"] = egress->get_status();
+        }
+
+        if (frame_tap) {
+            status["frame_tap"] = frame_tap->get_status();
+        }
+
+        if (preview) {
+            status["live_preview"] = preview->get_status();
+        }
+
         return status;
     }
 
+    // Slots held across all recorders; should drop back to zero once every stream is released
+    static size_t channels_in_use() {
+        std::lock_guard<std::mutex> lock(channel_mutex);
+        size_t count = 0;
+        for (bool used : used_channels) count += used ? 1 : 0;
+        return count;
+    }
+
 private:
+    bool create_canvas(obs_source_t* scene_source) {
+        struct obs_video_info ovi;
+        if (!obs_get_video_info(&ovi)) return false;
+
+        ovi.base_width = static_cast<uint32_t>(capture.width);
+        ovi.base_height = static_cast<uint32_t>(capture.height);
+        ovi.output_width = ovi.base_width;
+        ovi.output_height = ovi.base_height;
+
+        view = obs_view_create();
+        if (!view) return false;
+        obs_view_set_source(view, 0, scene_source);
+        stream_video = obs_view_add2(view, &ovi);
+        if (stream_video) MixComposites::getInstance()->add_mix(stream_video);
+        return stream_video != nullptr;
+    }
+
+    // Runs on the output thread just before each packet goes to the MP4 muxer
+    static void trace_packet_callback(obs_output_t*, struct encoder_packet* pkt,
+                                      struct encoder_packet_time* pkt_time, void* param) {
+        if (pkt->type != OBS_ENCODER_VIDEO || !pkt_time) return;
+
+        auto* self = static_cast<StreamRecorder*>(param);
+        FrameStamps stamps;
+        stamps.mux = os_gettime_ns();
+        stamps.pts = pkt_time->pts;
+        stamps.tick = pkt_time->cts;
+        stamps.composite = self->composites ? self->composites->composite_for(pkt_time->cts) : 0;
+        stamps.encode_request = pkt_time->fer;
+        stamps.encode_complete = pkt_time->ferc;
+        stamps.interleave = pkt_time->pir;
+        self->trace.record(stamps);
+        self->trace.add_cost(os_gettime_ns() - stamps.mux);
+    }
+
     void allocate_channels() {
         std::lock_guard<std::mutex> lock(channel_mutex);
 
@@ -498,10 +747,10 @@ private:
             used_channels.resize(MAX_CHANNELS, false);
         }
 
-        // Find free channels
+        // Find free channels; a stream with its own canvas renders its scene through its view instead
         for (int i = 0; i < MAX_CHANNELS; ++i) {
             if (!used_channels[i]) {
-                if (video_channel < 0) {
+                if (video_channel < 0 && !capture.uses_own_canvas()) {
                     video_channel = i;
                     used_channels[i] = true;
                 } else if (audio_channel < 0) {
@@ -538,6 +787,10 @@ private:
 
         std::cout << "Starting cleanup for stream: " << stream_id << std::endl;
 
+        // Egress output holds references to our encoders, release it first
+        egress.reset();
+        frame_tap.reset();
+
         if (output && obs_output_active(output)) {
             obs_output_stop(output);
             int wait_count = 0;
@@ -555,6 +808,8 @@ private:
 
         // Release resources
         if (output) {
+            obs_output_remove_packet_callback(output, trace_packet_callback, this);
+            if (preview) preview->detach(output);
             obs_output_release(output);
             output = nullptr;
         }
@@ -569,6 +824,18 @@ private:
             video_encoder = nullptr;
         }
 
+        // Encoders are gone, nothing reads the private canvas any more
+        if (view) {
+            if (stream_video) {
+                MixComposites::getInstance()->remove_mix(stream_video);
+                obs_view_remove(view);
+            }
+            obs_view_set_source(view, 0, nullptr);
+            obs_view_destroy(view);
+            view = nullptr;
+            stream_video = nullptr;
+        }
+
         if (mic_capture) {
             obs_source_release(mic_capture);
             mic_capture = nullptr;
@@ -604,9 +871,17 @@ std::vector<bool> StreamRecorder::used_channels;
 
 class RecordingManager {
 private:
+    // Declared before the server so its metrics outlive the server's task queue
+    RequestExecutor executor;
+    RouteTrie router;
     std::unique_ptr<httplib::Server> server;
     std::map<std::string, std::unique_ptr<StreamRecorder>> recorders;
+    // Streams whose OBS setup/teardown is running outside recorders_mutex ("starting"/"stopping")
+    std::map<std::string, const char*> pending_streams;
     std::mutex recorders_mutex;
+    std::condition_variable pending_cleared;    // notified whenever an entry leaves pending_streams
+    bool calibrating = false;                   // startup or POST /v1/encoder/calibrate running; starts are refused
+    std::thread calibration_thread;
 
 public:
     RecordingManager() : server(std::make_unique<httplib::Server>()) {
@@ -614,10 +889,22 @@ public:
         if (!OBSCore::getInstance()->initialize()) {
             throw std::runtime_error("Failed to initialize OBS core");
         }
+        // A cold cache means a benchmark of up to ~100 s. Reads are served meanwhile, but starts are
+        // refused: a stream encoding during the run would skew every measurement that gets cached.
+        calibrating = true;
+        calibration_thread = std::thread([this] {
+            calibrate_encoder(std::getenv("SCREENRECORDER_RECALIBRATE") != nullptr);
+            std::lock_guard<std::mutex> lock(recorders_mutex);
+            calibrating = false;
+        });
         setup_routes();
     }
 
     ~RecordingManager() {
+        EncoderCalibrator::getInstance()->cancel();
+        if (calibration_thread.joinable()) {
+            calibration_thread.join();
+        }
         // Clean up all recorders before shutting down OBS
         {
             std::lock_guard<std::mutex> lock(recorders_mutex);
@@ -626,89 +913,282 @@ public:
         // OBS core will be cleaned up automatically by its destructor
     }
 
-    void setup_routes() {
-        // Enable CORS
-        server->set_pre_routing_handler([](const httplib::Request& req, httplib::Response& res) {
-            res.set_header("Access-Control-Allow-Origin", "*");
-            res.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-            res.set_header("Access-Control-Allow-Headers", "Content-Type, Authorization");
-            return httplib::Server::HandlerResponse::Unhandled;
-        });
+    // Blocks until the startup benchmark (or cache load) is done and its OBS objects are released
+    void wait_for_calibration() {
+        if (calibration_thread.joinable()) {
+            calibration_thread.join();
+        }
+    }
+
+    // Stops and finalizes every stream concurrently under one deadline, after refusing new starts and
+    // letting in-flight starts/stops settle. Returns the per-stream drain report.
+    json drain() {
+        ShutdownCoordinator* coordinator = ShutdownCoordinator::getInstance();
+        coordinator->begin_drain();
+        // A running benchmark (startup or POST /v1/encoder/calibrate) would otherwise hold its
+        // request, and so stop_server(), for up to ~100 s; it stops after the current candidate
+        EncoderCalibrator::getInstance()->cancel();
+
+        std::vector<std::pair<std::string, ShutdownCoordinator::DrainTask>> tasks;
+        {
+            std::unique_lock<std::mutex> lock(recorders_mutex);
+            // A start that reserved its id before the flag flipped finishes within a second or so;
+            // waiting releases the lock so it (and status/list reads) can get through
+            pending_cleared.wait_until(lock, coordinator->get_stop_deadline(), [this] { return pending_streams.empty(); });
+
+            for (auto& pair : recorders) {
+                const std::string stream_id = pair.first;
+                std::shared_ptr<StreamRecorder> recorder(std::move(pair.second));
+                pending_streams[stream_id] = "stopping";
+                tasks.emplace_back(stream_id, [this, stream_id, recorder](std::chrono::steady_clock::time_point stop_by) mutable {
+                    const bool stopped = recorder->stop_recording(stop_by);
+                    const bool forced = recorder->was_force_stopped();
+                    // Releases the encoders and sources; the output is already stopped, so this is quick
+                    recorder.reset();
+                    CoreScheduler::getInstance()->release(stream_id);
+                    {
+                        std::lock_guard<std::mutex> lock(recorders_mutex);
+                        pending_streams.erase(stream_id);
+                        pending_cleared.notify_all();
+                    }
+                    return std::string(!stopped ? "not_recording" : forced ? "forced" : "finalized");
+                });
+            }
+            recorders.clear();
+        }
+
+        std::cout << "Draining " << tasks.size() << " stream(s), deadline "
+                  << coordinator->get_drain_timeout().count() << " ms" << std::endl;
+        const json report = coordinator->drain(std::move(tasks));
+        EncoderCalibrator::getInstance()->on_stream_count_changed(0);
+        return report;
+    }
 
-        // Handle preflight requests
-        server->Options(".*", [](const httplib::Request&, httplib::Response& res) {
-            return;
+    static bool calibrate_encoder(bool force) {
+        size_t width, height;
+        OBSCore::getInstance()->getVideoInfo(width, height);
+        struct obs_video_info ovi = {};
+        obs_get_video_info(&ovi);
+        const uint32_t fps = ovi.fps_den ? ovi.fps_num / ovi.fps_den : 30;
+        return EncoderCalibrator::getInstance()->calibrate(static_cast<uint32_t>(width),
+                                                           static_cast<uint32_t>(height), fps,
+                                                           OBSCore::getInstance()->calculateBitrate(), force);
+    }
+
+    void setup_routes() {
+        // Headers and body go out as separate writes; without TCP_NODELAY every keep-alive
+        // response waits on the peer's delayed ACK (~40 ms)
+        server->set_tcp_nodelay(true);
+
+        // Bounded worker pool; handlers below are admitted through read/mutation/control lanes
+        executor.install(*server);
+
+        // Routes are dispatched from a path trie instead of httplib's regex list; CORS
+        // headers are built once and copied into every response
+        router.install(*server, httplib::Headers{
+            {"Access-Control-Allow-Origin", "*"},
+            {"Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS"},
+            {"Access-Control-Allow-Headers", "Content-Type, Authorization"}
         });
 
         // POST /v1/stream/{streamId}/start
-        server->Post("/v1/stream/([^/]+)/start", [this](const httplib::Request& req, httplib::Response& res) {
-            std::string stream_id = req.matches[1];
+        router.Post("/v1/stream/:stream_id/start", executor.mutation([this](const httplib::Request& req, httplib::Response& res, const RouteParams& params) {
+            std::string stream_id(params[0]);
+            bool reserved = false;
 
             try {
-                std::lock_guard<std::mutex> lock(recorders_mutex);
+                // Optional body: {"egress": {"url": "srt://...", "latency_ms": 200, "buffer_ms": 1000},
+                //                 "frame_tap": {"slots": 4, "fps_divisor": 1},
+                //                 "capture": {"type": "region", "x": 0, "y": 0, "width": 1280, "height": 720}}
+                std::unique_ptr<EgressConfig> egress_config;
+                std::unique_ptr<FrameTapConfig> frame_tap_config;
+                CaptureTarget capture_target;
+                if (!req.body.empty()) {
+                    const json body = json::parse(req.body, nullptr, false);
+                    std::string invalid;
+                    if (!body.is_object()) {
+                        invalid = "Request body must be a JSON object";
+                    } else if (body.contains("egress")) {
+                        egress_config = std::make_unique<EgressConfig>();
+                        EgressConfig::parse(body, *egress_config, invalid);
+                    }
+                    if (invalid.empty() && body.is_object() && body.contains("frame_tap") &&
+                        body["frame_tap"] != false) {
+                        frame_tap_config = std::make_unique<FrameTapConfig>();
+                        FrameTapConfig::parse(body, *frame_tap_config, invalid);
+                    }
+                    if (invalid.empty() && body.is_object() && body.contains("capture")) {
+                        CaptureTarget::parse(body, OBSCore::getDisplayPixelSize, OBSCore::getWindowPixelSize,
+                                             capture_target, invalid);
+                    }
+                    if (!invalid.empty()) {
+                        json error_response;
+                        error_response["error"] = invalid;
+                        error_response["stream_id"] = stream_id;
+                        res.status = 400;
+                        res.set_content(error_response.dump(), "application/json");
+                        return;
+                    }
+                }
 
-                // Check if recorder already exists
-                if (recorders.find(stream_id) != recorders.end()) {
-                    json error_response;
-                    error_response["error"] = "Stream already exists";
-                    error_response["stream_id"] = stream_id;
-                    res.status = 409; // Conflict
-                    res.set_content(error_response.dump(), "application/json");
-                    return;
+                size_t expected_streams;
+                {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+
+                    // Checked under the lock: drain() waits for every stream reserved before this flipped
+                    if (ShutdownCoordinator::getInstance()->is_draining()) {
+                        json error_response;
+                        error_response["error"] = "Server is shutting down";
+                        error_response["stream_id"] = stream_id;
+                        res.status = 503;
+                        res.set_header("Retry-After", "30");
+                        res.set_content(error_response.dump(), "application/json");
+                        return;
+                    }
+
+                    if (calibrating) {
+                        json error_response;
+                        error_response["error"] = "Encoder calibration in progress";
+                        error_response["stream_id"] = stream_id;
+                        res.status = 409;
+                        res.set_header("Retry-After", "10");
+                        res.set_content(error_response.dump(), "application/json");
+                        return;
+                    }
+
+                    // Check if recorder already exists (or is still being set up/torn down)
+                    if (recorders.find(stream_id) != recorders.end() ||
+                        pending_streams.find(stream_id) != pending_streams.end()) {
+                        json error_response;
+                        error_response["error"] = "Stream already exists";
+                        error_response["stream_id"] = stream_id;
+                        res.status = 409; // Conflict
+                        res.set_content(error_response.dump(), "application/json");
+                        return;
+                    }
+
+                    // Another live producer (e.g. a second server instance) owns the ring's name
+                    if (frame_tap_config && FrameTapWriter::in_use(frame_tap_shm_name(stream_id))) {
+                        json error_response;
+                        error_response["error"] = "Frame tap segment is in use";
+                        error_response["stream_id"] = stream_id;
+                        error_response["frame_tap_shm"] = frame_tap_shm_name(stream_id);
+                        res.status = 409;
+                        res.set_content(error_response.dump(), "application/json");
+                        return;
+                    }
+
+                    pending_streams[stream_id] = "starting";
+                    reserved = true;
+                    expected_streams = recorders.size() + pending_streams.size();
                 }
 
-                // Create new recorder
+                // OBS setup is slow (encoder creation alone can take hundreds of ms), so it runs
+                // without recorders_mutex to keep status/list polling responsive
                 auto recorder = std::make_unique<StreamRecorder>(stream_id);
+                std::string failure;
+
+                // The core scheduler sets this stream's x264 thread budget; calibration picks among
+                // what it measured within that budget, so preset and thread count were benchmarked together
+                const CoreAssignment cores = CoreScheduler::getInstance()->assign(stream_id, expected_streams);
+                EncoderProfile profile = EncoderCalibrator::getInstance()->select(expected_streams, cores.threads);
+                if (cores.threads > 0 && (profile.threads == 0 || profile.threads > cores.threads)) {
+                    profile.threads = cores.threads;    // uncalibrated default
+                }
 
-                if (!recorder->setup_sources()) {
-                    json error_response;
-                    error_response["error"] = "Failed to setup sources";
-                    error_response["stream_id"] = stream_id;
-                    res.status = 500;
-                    res.set_content(error_response.dump(), "application/json");
-                    return;
+                if (!recorder->setup_sources(capture_target)) {
+                    failure = "Failed to setup sources";
+                } else if (!recorder->setup_encoding(profile)) {
+                    failure = "Failed to setup encoding";
+                } else if (!recorder->start_recording()) {
+                    failure = "Failed to start recording";
+                }
+
+                // The recording is the product; a receiver that isn't up yet must not fail it
+                bool egress_started = false;
+                if (failure.empty() && egress_config) {
+                    egress_started = recorder->start_egress(*egress_config);
+                }
+                bool frame_tap_started = false;
+                if (failure.empty() && frame_tap_config) {
+                    frame_tap_started = recorder->start_frame_tap(*frame_tap_config);
                 }
 
-                if (!recorder->setup_encoding()) {
+                const std::string output_file = recorder->get_output_file();
+                bool too_late = false;
+                {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+                    pending_streams.erase(stream_id);
+                    pending_cleared.notify_all();
+                    reserved = false;
+
+                    // Store recorder, unless drain() gave up waiting for us and already took the list
+                    if (failure.empty() && ShutdownCoordinator::getInstance()->is_draining()) {
+                        too_late = true;
+                    } else if (failure.empty()) {
+                        recorders[stream_id] = std::move(recorder);
+                        EncoderCalibrator::getInstance()->on_stream_count_changed(recorders.size());
+                    }
+                }
+                if (too_late) {
+                    recorder->stop_recording();
+                    recorder.reset();
+                    CoreScheduler::getInstance()->release(stream_id);
                     json error_response;
-                    error_response["error"] = "Failed to setup encoding";
+                    error_response["error"] = "Server is shutting down";
                     error_response["stream_id"] = stream_id;
-                    res.status = 500;
+                    res.status = 503;
+                    res.set_header("Retry-After", "30");
                     res.set_content(error_response.dump(), "application/json");
                     return;
                 }
+                if (!failure.empty()) {
+                    CoreScheduler::getInstance()->release(stream_id);
+                }
 
-                if (!recorder->start_recording()) {
+                if (!failure.empty()) {
                     json error_response;
-                    error_response["error"] = "Failed to start recording";
+                    error_response["error"] = failure;
                     error_response["stream_id"] = stream_id;
                     res.status = 500;
                     res.set_content(error_response.dump(), "application/json");
                     return;
                 }
 
-                // Store recorder
-                recorders[stream_id] = std::move(recorder);
-
                 json response;
                 response["message"] = "Recording started";
                 response["stream_id"] = stream_id;
-                response["output_file"] = recorders[stream_id]->get_output_file();
+                response["output_file"] = output_file;
+                response["capture"] = capture_target.to_json();
+                if (egress_config) {
+                    response["egress_url"] = egress_config->url;
+                    response["egress_started"] = egress_started;
+                }
+                if (frame_tap_config) {
+                    response["frame_tap_shm"] = frame_tap_shm_name(stream_id);
+                    response["frame_tap_started"] = frame_tap_started;
+                }
                 res.status = 200;
                 res.set_content(response.dump(), "application/json");
 
             } catch (const std::exception& e) {
+                if (reserved) {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+                    pending_streams.erase(stream_id);
+                    pending_cleared.notify_all();
+                }
+                CoreScheduler::getInstance()->release(stream_id);
                 json error_response;
                 error_response["error"] = "Internal server error";
                 error_response["details"] = e.what();
                 res.status = 500;
                 res.set_content(error_response.dump(), "application/json");
             }
-        });
+        }));
 
         // PUT /v1/stream/{streamId}/pause
-        server->Put("/v1/stream/([^/]+)/pause", [this](const httplib::Request& req, httplib::Response& res) {
-            std::string stream_id = req.matches[1];
+        router.Put("/v1/stream/:stream_id/pause", executor.control([this](const httplib::Request& req, httplib::Response& res, const RouteParams& params) {
+            std::string stream_id(params[0]);
 
             try {
                 std::lock_guard<std::mutex> lock(recorders_mutex);
@@ -745,28 +1225,51 @@ public:
                 res.status = 500;
                 res.set_content(error_response.dump(), "application/json");
             }
-        });
+        }));
 
         // DELETE /v1/stream/{streamId}/stop
-        server->Delete("/v1/stream/([^/]+)/stop", [this](const httplib::Request& req, httplib::Response& res) {
-            std::string stream_id = req.matches[1];
+        router.Delete("/v1/stream/:stream_id/stop", executor.mutation([this](const httplib::Request& req, httplib::Response& res, const RouteParams& params) {
+            std::string stream_id(params[0]);
+            std::unique_ptr<StreamRecorder> recorder;
 
             try {
-                std::lock_guard<std::mutex> lock(recorders_mutex);
-
-                auto it = recorders.find(stream_id);
-                if (it == recorders.end()) {
-                    json error_response;
-                    error_response["error"] = "Stream not found";
-                    error_response["stream_id"] = stream_id;
-                    res.status = 404;
-                    res.set_content(error_response.dump(), "application/json");
-                    return;
+                {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+
+                    auto it = recorders.find(stream_id);
+                    if (it == recorders.end()) {
+                        json error_response;
+                        error_response["error"] = "Stream not found";
+                        error_response["stream_id"] = stream_id;
+                        res.status = 404;
+                        res.set_content(error_response.dump(), "application/json");
+                        return;
+                    }
+
+                    // Take the recorder out so the (up to 3 s) output stop runs without the lock
+                    recorder = std::move(it->second);
+                    recorders.erase(it);
+                    pending_streams[stream_id] = "stopping";
                 }
 
-                std::string output_file = it->second->get_output_file();
+                std::string output_file = recorder->get_output_file();
+                const bool stopped = recorder->stop_recording();
+
+                {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+                    pending_streams.erase(stream_id);
+                    pending_cleared.notify_all();
+                    if (!stopped) {
+                        recorders[stream_id] = std::move(recorder);
+                    } else {
+                        EncoderCalibrator::getInstance()->on_stream_count_changed(recorders.size());
+                    }
+                }
+                if (stopped) {
+                    CoreScheduler::getInstance()->release(stream_id);
+                }
 
-                if (!it->second->stop_recording()) {
+                if (!stopped) {
                     json error_response;
                     error_response["error"] = "Failed to stop recording";
                     error_response["stream_id"] = stream_id;
@@ -776,7 +1279,7 @@ public:
                 }
 
                 // Remove recorder after stopping
-                recorders.erase(it);
+                recorder.reset();
 
                 json response;
                 response["message"] = "Recording stopped";
@@ -786,22 +1289,38 @@ public:
                 res.set_content(response.dump(), "application/json");
 
             } catch (const std::exception& e) {
+                if (recorder) {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+                    pending_streams.erase(stream_id);
+                    pending_cleared.notify_all();
+                    recorders[stream_id] = std::move(recorder);
+                }
                 json error_response;
                 error_response["error"] = "Internal server error";
                 error_response["details"] = e.what();
                 res.status = 500;
                 res.set_content(error_response.dump(), "application/json");
             }
-        });
+        }));
 
         // GET /v1/stream/{streamId}/status
-        server->Get("/v1/stream/([^/]+)/status", [this](const httplib::Request& req, httplib::Response& res) {
-            std::string stream_id = req.matches[1];
+        router.Get("/v1/stream/:stream_id/status", executor.read([this](const httplib::Request& req, httplib::Response& res, const RouteParams& params) {
+            std::string stream_id(params[0]);
 
             try {
                 std::lock_guard<std::mutex> lock(recorders_mutex);
 
                 auto it = recorders.find(stream_id);
+                const auto pending = pending_streams.find(stream_id);
+                if (it == recorders.end() && pending != pending_streams.end()) {
+                    json response;
+                    response["stream_id"] = stream_id;
+                    response["state"] = pending->second;
+                    res.status = 200;
+                    res.set_content(response.dump(), "application/json");
+                    return;
+                }
+
                 if (it == recorders.end()) {
                     json error_response;
                     error_response["error"] = "Stream not found";
@@ -822,17 +1341,85 @@ public:
                 res.status = 500;
                 res.set_content(error_response.dump(), "application/json");
             }
-        });
+        }));
+
+        // GET /v1/stream/{streamId}/trace - Per-stage frame latencies; ?samples=1 adds sampled raw stamps
+        router.Get("/v1/stream/:stream_id/trace", executor.read([this](const httplib::Request& req, httplib::Response& res, const RouteParams& params) {
+            std::string stream_id(params[0]);
+
+            try {
+                std::lock_guard<std::mutex> lock(recorders_mutex);
+
+                auto it = recorders.find(stream_id);
+                if (it == recorders.end()) {
+                    json error_response;
+                    error_response["error"] = "Stream not found";
+                    error_response["stream_id"] = stream_id;
+                    res.status = 404;
+                    res.set_content(error_response.dump(), "application/json");
+                    return;
+                }
+
+                json response = it->second->get_trace(req.get_param_value("samples") == "1");
+                response["render"] = OBSCore::getInstance()->getRenderStats();
+                res.status = 200;
+                res.set_content(response.dump(), "application/json");
+
+            } catch (const std::exception& e) {
+                json error_response;
+                error_response["error"] = "Internal server error";
+                error_response["details"] = e.what();
+                res.status = 500;
+                res.set_content(error_response.dump(), "application/json");
+            }
+        }));
+
+        // GET /v1/stream/{streamId}/live/{file} - LL-HLS preview (index.m3u8, init.mp4, parts, segments)
+        router.Get("/v1/stream/:stream_id/live/:file", executor.read([this](const httplib::Request& req, httplib::Response& res, const RouteParams& params) {
+            std::string stream_id(params[0]);
+
+            try {
+                // Blocking playlist reloads wait on the preview, not on recorders_mutex
+                std::shared_ptr<LivePreview> preview;
+                {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+                    auto it = recorders.find(stream_id);
+                    if (it != recorders.end()) {
+                        preview = it->second->get_preview();
+                    }
+                }
+
+                if (!preview) {
+                    json error_response;
+                    error_response["error"] = "Stream not found";
+                    error_response["stream_id"] = stream_id;
+                    res.status = 404;
+                    res.set_content(error_response.dump(), "application/json");
+                    return;
+                }
+
+                preview->serve(std::string(params[1]), req, res);
+
+            } catch (const std::exception& e) {
+                json error_response;
+                error_response["error"] = "Internal server error";
+                error_response["details"] = e.what();
+                res.status = 500;
+                res.set_content(error_response.dump(), "application/json");
+            }
+        }));
 
         // GET /v1/streams - List all streams
-        server->Get("/v1/streams", [this](const httplib::Request& req, httplib::Response& res) {
+        router.Get("/v1/streams", executor.read([this](const httplib::Request& req, httplib::Response& res, const RouteParams&) {
             try {
                 std::lock_guard<std::mutex> lock(recorders_mutex);
 
                 json response;
                 response["streams"] = json::array();
                 response["active_streams"] = recorders.size();
+                response["pending_streams"] = pending_streams.size();
                 response["obs_core_initialized"] = OBSCore::getInstance()->isInitialized();
+                response["channels_in_use"] = StreamRecorder::channels_in_use();
 
                 for (const auto& pair : recorders) {
                     response["streams"].push_back(pair.second->get_status());
@@ -848,26 +1435,122 @@ public:
                 res.status = 500;
                 res.set_content(error_response.dump(), "application/json");
             }
+        }));
+
+        // GET /v1/encoder/profile - Calibration table and the profile the next stream will use
+        router.Get("/v1/encoder/profile", executor.read([](const httplib::Request& req, httplib::Response& res, const RouteParams&) {
+            json response = EncoderCalibrator::getInstance()->get_status();
+            response["core_scheduler"] = CoreScheduler::getInstance()->get_status();
+            res.status = 200;
+            res.set_content(response.dump(), "application/json");
+        }));
+
+        // POST /v1/encoder/calibrate - Re-run the benchmark (only while nothing is recording)
+        router.Post("/v1/encoder/calibrate", executor.mutation([this](const httplib::Request& req, httplib::Response& res, const RouteParams&) {
+            bool reserved = false;
+            try {
+                {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+
+                    // drain() has already cancelled the calibrator; a new run would only measure the baseline
+                    if (ShutdownCoordinator::getInstance()->is_draining()) {
+                        json error_response;
+                        error_response["error"] = "Server is shutting down";
+                        res.status = 503;
+                        res.set_header("Retry-After", "30");
+                        res.set_content(error_response.dump(), "application/json");
+                        return;
+                    }
+                    if (!recorders.empty() || !pending_streams.empty()) {
+                        json error_response;
+                        error_response["error"] = "Cannot calibrate while streams are active";
+                        error_response["active_streams"] = recorders.size();
+                        res.status = 409;
+                        res.set_content(error_response.dump(), "application/json");
+                        return;
+                    }
+                    if (calibrating || EncoderCalibrator::getInstance()->is_calibrating()) {
+                        json error_response;
+                        error_response["error"] = "Encoder calibration already running";
+                        res.status = 409;
+                        res.set_content(error_response.dump(), "application/json");
+                        return;
+                    }
+
+                    // Holds off starts; the benchmark itself runs without the lock so reads keep flowing
+                    calibrating = true;
+                    reserved = true;
+                }
+
+                const bool calibrated = calibrate_encoder(true);
+                {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+                    calibrating = false;
+                    reserved = false;
+                }
+
+                if (!calibrated && ShutdownCoordinator::getInstance()->is_draining()) {
+                    json error_response;
+                    error_response["error"] = "Encoder calibration cancelled, server is shutting down";
+                    res.status = 503;
+                    res.set_content(error_response.dump(), "application/json");
+                    return;
+                }
+                if (!calibrated) {
+                    json error_response;
+                    error_response["error"] = "Encoder calibration failed";
+                    res.status = 500;
+                    res.set_content(error_response.dump(), "application/json");
+                    return;
+                }
+
+                json response = EncoderCalibrator::getInstance()->get_status();
+                res.status = 200;
+                res.set_content(response.dump(), "application/json");
+
+            } catch (const std::exception& e) {
+                if (reserved) {
+                    std::lock_guard<std::mutex> lock(recorders_mutex);
+                    calibrating = false;
+                }
+                json error_response;
+                error_response["error"] = "Internal server error";
+                error_response["details"] = e.what();
+                res.status = 500;
+                res.set_content(error_response.dump(), "application/json");
+            }
+        }));
+
+        // GET /v1/metrics - Connection queue and admission lane depth/wait times (never gated)
+        router.Get("/v1/metrics", [this](const httplib::Request& req, httplib::Response& res, const RouteParams&) {
+            json response = executor.get_metrics();
+            res.status = 200;
+            res.set_content(response.dump(), "application/json");
         });
 
         // Health check endpoint
-        server->Get("/health", [](const httplib::Request& req, httplib::Response& res) {
+        router.Get("/health", executor.read([](const httplib::Request& req, httplib::Response& res, const RouteParams&) {
             json response;
-            response["status"] = "healthy";
+            response["status"] = ShutdownCoordinator::getInstance()->is_draining() ? "draining" : "healthy";
             response["service"] = "obs-singleton-recorder-api";
             response["obs_core"] = OBSCore::getInstance()->isInitialized() ? "initialized" : "not initialized";
             res.set_content(response.dump(), "application/json");
-        });
+        }));
     }
 
     void start_server(const std::string& host = "0.0.0.0", int port = 8080) {
         std::cout << "Starting OBS Singleton Recording API server on " << host << ":" << port << std::endl;
         std::cout << "Available endpoints:" << std::endl;
-        std::cout << "  POST   /v1/stream/{streamId}/start" << std::endl;
+        std::cout << "  POST   /v1/stream/{streamId}/start  (optional body: {\"capture\":{...},\"egress\":{...},\"frame_tap\":true})" << std::endl;
         std::cout << "  PUT    /v1/stream/{streamId}/pause" << std::endl;
         std::cout << "  DELETE /v1/stream/{streamId}/stop" << std::endl;
         std::cout << "  GET    /v1/stream/{streamId}/status" << std::endl;
+        std::cout << "  GET    /v1/stream/{streamId}/trace[?samples=1]" << std::endl;
+        std::cout << "  GET    /v1/stream/{streamId}/live/index.m3u8  (LL-HLS preview)" << std::endl;
         std::cout << "  GET    /v1/streams" << std::endl;
+        std::cout << "  GET    /v1/encoder/profile" << std::endl;
+        std::cout << "  POST   /v1/encoder/calibrate" << std::endl;
+        std::cout << "  GET    /v1/metrics" << std::endl;
         std::cout << "  GET    /health" << std::endl;
         std::cout << "\nRecordings will be saved to: /tmp/" << std::endl;
         std::cout << "Using singleton OBS core for all recordings" << std::endl;
@@ -882,10 +1565,10 @@ public:
     }
 };
 
+#ifndef SCREENRECORDER_NO_MAIN
 int main(int argc, char* argv[]) {
-    // Setup signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // Before OBS and the server start their threads, so only wait_for_signal() ever sees SIGINT/SIGTERM
+    ShutdownCoordinator::getInstance()->block_signals();
 
     std::cout << "OBS Singleton MP4 Recording API for M1 MacBook Pro" << std::endl;
     std::cout << "=================================================" << std::endl;
@@ -910,9 +1593,12 @@ int main(int argc, char* argv[]) {
         });
 
         // Wait for shutdown signal
-        while (!should_stop) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
+        const int received = ShutdownCoordinator::getInstance()->wait_for_signal();
+        std::cout << "\nReceived signal " << received << ", draining streams..." << std::endl;
+
+        // The API stays up while draining so status polls keep working; starts get 503
+        const json report = manager.drain();
+        ShutdownCoordinator::write_report(report);
 
         // Stop server
         manager.stop_server();
@@ -922,6 +1608,13 @@ int main(int argc, char* argv[]) {
             server_thread.join();
         }
 
+        if (!report["complete"].get<bool>()) {
+            // A stream thread is still inside OBS; tearing down the core under it would hang or crash
+            std::cerr << "Drain deadline missed, exiting without OBS shutdown" << std::endl;
+            std::cout.flush();
+            std::_Exit(1);
+        }
+
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
@@ -929,4 +1622,5 @@ int main(int argc, char* argv[]) {
 
     std::cout << "Server stopped successfully" << std::endl;
     return 0;
-}
\ No newline at end of file
+}
+#endif  // SCREENRECORDER_NO_MAIN
@@ -0,0 +1,266 @@
+// pipeline_trace.h - Per-frame stage latencies (capture tick -> composite -> encode -> interleave -> mux)
+#pragma once
+
+#include "third_party/json.hpp"
+#include "latency_histogram.h"
+#include <atomic>
+#include <array>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+using json = nlohmann::json;
+
+// os_gettime_ns() stamps for one video frame. OBS carries tick/encode/interleave in the
+// packet's encoder_packet_time; composite comes from the stream's mix in MixComposites and mux from the output
+// packet callback, which runs right before the packet is handed to the muxer.
+struct FrameStamps {
+    int64_t pts = 0;
+    uint64_t tick = 0;              // cts: the frame's tick time, sources ticked/captured for it
+    uint64_t composite = 0;         // the stream's mix finished rendering this frame
+    uint64_t encode_request = 0;    // fer: frame submitted to the encoder
+    uint64_t encode_complete = 0;   // ferc: encoder returned
+    uint64_t interleave = 0;        // pir: packet reached the output's interleaver
+    uint64_t mux = 0;               // packet handed to the muxer
+};
+
+// Ring of recent composites for one mix: the frame time OBS rendered (obs_get_video_frame_time(),
+// the same value it stamps into the frame and so into each packet's cts) and when that mix's render
+// finished. Written only from the graphics thread; an entry is zeroed while rewritten.
+class CompositeRing {
+private:
+    // Packets leave x264 up to rc_lookahead (<= 60) plus one frame per encoder thread after their tick
+    static constexpr size_t SIZE = 128;
+    struct Entry {
+        std::atomic<uint64_t> frame_time{0};
+        std::atomic<uint64_t> rendered{0};
+    };
+    std::array<Entry, SIZE> entries;
+    std::atomic<uint64_t> next{0};
+
+public:
+    void push(uint64_t frame_time, uint64_t rendered_ns) {
+        const uint64_t i = next.load(std::memory_order_relaxed);
+        Entry& entry = entries[i % SIZE];
+        entry.frame_time.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        entry.rendered.store(rendered_ns, std::memory_order_relaxed);
+        entry.frame_time.store(frame_time, std::memory_order_release);
+        next.store(i + 1, std::memory_order_release);
+    }
+
+    // Render completion for the frame ticked at frame_time; 0 if it has been overwritten
+    uint64_t composite_for(uint64_t frame_time) const {
+        const uint64_t end = next.load(std::memory_order_acquire);
+        const uint64_t begin = end > SIZE ? end - SIZE : 0;
+        for (uint64_t i = end; i > begin; --i) {
+            const Entry& entry = entries[(i - 1) % SIZE];
+            if (entry.frame_time.load(std::memory_order_acquire) != frame_time) continue;
+            const uint64_t rendered = entry.rendered.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (entry.frame_time.load(std::memory_order_relaxed) == frame_time) return rendered;
+        }
+        return 0;
+    }
+};
+
+// libobs runs the main-rendered callback once per mix per frame, all with the same frame time, in
+// mix order: the main mix, then every view's mix in obs_view_add2() order. The callback is not told
+// which mix it is for, so the n-th call within a frame is attributed to the n-th registered mix.
+// Every obs_view_add2()/obs_view_remove() in the process has to be mirrored here; a view added or
+// removed mid-frame can misattribute that one frame.
+class MixComposites {
+private:
+    static inline std::unique_ptr<MixComposites> instance;
+    static inline std::mutex instance_mutex;
+
+    std::mutex mutex;
+    std::vector<std::pair<const void*, std::shared_ptr<CompositeRing>>> mixes;     // render order
+    uint64_t frame_time = 0;    // graphics thread: frame being rendered and mixes seen so far
+    size_t call = 0;
+
+    MixComposites() = default;
+
+public:
+    static MixComposites* getInstance() {
+        std::lock_guard<std::mutex> lock(instance_mutex);
+        if (!instance) {
+            instance = std::unique_ptr<MixComposites>(new MixComposites());
+        }
+        return instance.get();
+    }
+
+    // After obs_reset_video() (the main mix) or a successful obs_view_add2()
+    void add_mix(const void* video) {
+        std::lock_guard<std::mutex> lock(mutex);
+        mixes.emplace_back(video, std::make_shared<CompositeRing>());
+    }
+
+    // Right before obs_view_remove() (or obs_shutdown() for the main mix)
+    void remove_mix(const void* video) {
+        std::lock_guard<std::mutex> lock(mutex);
+        mixes.erase(std::remove_if(mixes.begin(), mixes.end(),
+                                   [video](const auto& mix) { return mix.first == video; }),
+                    mixes.end());
+    }
+
+    // Composites of one mix; stays valid after the mix is removed
+    std::shared_ptr<const CompositeRing> ring_for(const void* video) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& mix : mixes) {
+            if (mix.first == video) return mix.second;
+        }
+        return nullptr;
+    }
+
+    // Graphics thread, from the main-rendered callback
+    void on_rendered(uint64_t rendered_frame_time, uint64_t rendered_ns) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (rendered_frame_time != frame_time) {
+            frame_time = rendered_frame_time;
+            call = 0;
+        }
+        const size_t index = call++;
+        if (index < mixes.size()) mixes[index].second->push(rendered_frame_time, rendered_ns);
+    }
+};
+
+class PipelineTrace {
+public:
+    enum Stage {
+        CAPTURE_TO_COMPOSITE,
+        COMPOSITE_TO_ENCODER,
+        ENCODE,
+        ENCODER_TO_INTERLEAVE,
+        INTERLEAVE_TO_MUX,
+        TOTAL,
+        STAGE_COUNT
+    };
+
+    static constexpr const char* stage_name(Stage stage) {
+        switch (stage) {
+            case CAPTURE_TO_COMPOSITE: return "capture_to_composite";
+            case COMPOSITE_TO_ENCODER: return "composite_to_encoder";
+            case ENCODE: return "encode";
+            case ENCODER_TO_INTERLEAVE: return "encoder_to_interleave";
+            case INTERLEAVE_TO_MUX: return "interleave_to_mux";
+            case TOTAL: return "total";
+            default: return "unknown";
+        }
+    }
+
+private:
+    static constexpr size_t MAX_SAMPLES = 256;
+
+    std::array<LatencyHistogram, STAGE_COUNT> stage_ns;
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> incomplete{0};
+    std::atomic<uint64_t> record_cost_ns{0};
+    uint32_t sample_every;
+
+    // Sampled raw stamps for offline inspection; only every sample_every-th frame takes the lock
+    std::mutex samples_mutex;
+    std::vector<FrameStamps> samples;
+    size_t samples_next = 0;
+
+    void add(Stage stage, uint64_t from, uint64_t to) {
+        if (from && to >= from) stage_ns[stage].record(to - from);
+    }
+
+public:
+    explicit PipelineTrace(uint32_t sample_every_n = 30) : sample_every(sample_every_n) {
+        samples.reserve(MAX_SAMPLES);
+    }
+
+    // Called once per video packet on the output thread
+    void record(const FrameStamps& s) {
+        const uint64_t n = frames.fetch_add(1, std::memory_order_relaxed);
+        if (!s.tick || !s.composite || !s.encode_request || !s.encode_complete || !s.interleave) {
+            incomplete.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        add(CAPTURE_TO_COMPOSITE, s.tick, s.composite);
+        add(COMPOSITE_TO_ENCODER, s.composite, s.encode_request);
+        add(ENCODE, s.encode_request, s.encode_complete);
+        add(ENCODER_TO_INTERLEAVE, s.encode_complete, s.interleave);
+        add(INTERLEAVE_TO_MUX, s.interleave, s.mux);
+        add(TOTAL, s.tick ? s.tick : s.composite, s.mux);
+
+        if (sample_every && n % sample_every == 0) {
+            std::lock_guard<std::mutex> lock(samples_mutex);
+            if (samples.size() < MAX_SAMPLES) {
+                samples.push_back(s);
+            } else {
+                samples[samples_next] = s;
+            }
+            samples_next = (samples_next + 1) % MAX_SAMPLES;
+        }
+    }
+
+    // Time the caller spent in its packet callback, reported as the tracing overhead
+    void add_cost(uint64_t ns) {
+        record_cost_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    json get_status(double elapsed_seconds) const {
+        json status;
+        status["frames"] = frames.load(std::memory_order_relaxed);
+        status["incomplete_frames"] = incomplete.load(std::memory_order_relaxed);
+        for (int i = 0; i < STAGE_COUNT; ++i) {
+            const LatencyHistogram& h = stage_ns[i];
+            status["stages_ms"][stage_name(static_cast<Stage>(i))] = {
+                {"p50", h.percentile(0.50) / 1e6},
+                {"p99", h.percentile(0.99) / 1e6},
+                {"max", h.max() / 1e6}
+            };
+        }
+        const uint64_t cost = record_cost_ns.load(std::memory_order_relaxed);
+        const uint64_t traced = frames.load(std::memory_order_relaxed);
+        status["trace_cost_us_per_frame"] = traced ? static_cast<double>(cost) / 1000.0 / static_cast<double>(traced) : 0.0;
+        status["trace_cpu_percent"] = elapsed_seconds > 0 ? static_cast<double>(cost) / 1e9 / elapsed_seconds * 100.0 : 0.0;
+        return status;
+    }
+
+    // Tick -> composite is a single render pass; at or above a frame interval the graphics
+    // thread is behind, or the stamps are not from the same frame
+    bool composite_within(uint64_t frame_interval_ns) const {
+        const LatencyHistogram& h = stage_ns[CAPTURE_TO_COMPOSITE];
+        return frames.load(std::memory_order_relaxed) == 0 || h.percentile(0.99) < frame_interval_ns;
+    }
+
+    // Oldest first; stamps relative to the frame's tick (or composite) in microseconds
+    json dump_samples() {
+        std::vector<FrameStamps> ordered;
+        {
+            std::lock_guard<std::mutex> lock(samples_mutex);
+            if (samples.size() < MAX_SAMPLES) {
+                ordered = samples;
+            } else {
+                ordered.insert(ordered.end(), samples.begin() + samples_next, samples.end());
+                ordered.insert(ordered.end(), samples.begin(), samples.begin() + samples_next);
+            }
+        }
+
+        json dump = json::array();
+        for (const FrameStamps& s : ordered) {
+            const uint64_t origin = s.tick ? s.tick : s.composite;
+            auto rel = [origin](uint64_t t) -> json {
+                return t && t >= origin ? json((t - origin) / 1000.0) : json(nullptr);
+            };
+            dump.push_back({
+                {"pts", s.pts},
+                {"origin_ns", origin},
+                {"tick_us", rel(s.tick)},
+                {"composite_us", rel(s.composite)},
+                {"encode_request_us", rel(s.encode_request)},
+                {"encode_complete_us", rel(s.encode_complete)},
+                {"interleave_us", rel(s.interleave)},
+                {"mux_us", rel(s.mux)}
+            });
+        }
+        return dump;
+    }
+};
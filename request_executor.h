@@ -0,0 +1,343 @@
+// request_executor.h - Bounded httplib task queue plus read/mutation/control admission lanes with 429 backpressure
+#pragma once
+
+#include "third_party/httplib.h"
+#include "third_party/json.hpp"
+#include "latency_histogram.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <algorithm>
+
+using json = nlohmann::json;
+
+struct ExecutorConfig {
+    // Each keep-alive connection pins a worker until it goes idle, so size this for concurrent
+    // clients rather than cores; the lanes below do the actual admission control
+    size_t worker_threads = 64;
+    size_t connection_backlog = 64;     // accepted sockets waiting for a worker
+    size_t read_concurrency = 0;        // 0 = one per worker
+    size_t read_queue = 64;
+    size_t mutation_concurrency = 0;    // 0 = one per core; start/stop set up and tear down OBS outside recorders_mutex
+    size_t mutation_queue = 16;
+    size_t control_concurrency = 4;     // pause is one OBS call and must not queue behind a start/stop
+    size_t control_queue = 16;
+    std::chrono::milliseconds max_lane_wait{10000};
+};
+
+// Workers that are never handed to the mutation lane, so reads always have a thread
+static constexpr size_t RESERVED_READ_WORKERS = 2;
+
+// Replacement for httplib::ThreadPool. httplib hands us whole connections (a keep-alive
+// socket stays on one worker until it goes idle), so this level can only bound the backlog;
+// per-request priority is handled by RequestLane. When the backlog is full the socket is
+// closed before any bytes are read, which clients see as a connection reset.
+class BoundedTaskQueue final : public httplib::TaskQueue {
+public:
+    struct Metrics {
+        std::atomic<size_t> depth{0};
+        std::atomic<size_t> peak_depth{0};
+        std::atomic<size_t> busy_workers{0};
+        std::atomic<uint64_t> accepted{0};
+        std::atomic<uint64_t> rejected{0};
+        LatencyHistogram wait_us;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::thread> threads;
+    std::deque<std::pair<std::function<void()>, Clock::time_point>> jobs;
+    size_t max_queued;
+    bool shutting_down = false;
+    std::mutex mutex;
+    std::condition_variable cond;
+    Metrics& metrics;
+
+    void worker() {
+        for (;;) {
+            std::function<void()> fn;
+            Clock::time_point queued_at;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this] { return !jobs.empty() || shutting_down; });
+                if (shutting_down && jobs.empty()) break;
+
+                fn = std::move(jobs.front().first);
+                queued_at = jobs.front().second;
+                jobs.pop_front();
+                metrics.depth = jobs.size();
+            }
+
+            metrics.wait_us.record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - queued_at).count()));
+            metrics.busy_workers++;
+            fn();
+            metrics.busy_workers--;
+        }
+    }
+
+public:
+    BoundedTaskQueue(size_t n, size_t max_queued_connections, Metrics& m)
+        : max_queued(max_queued_connections), metrics(m) {
+        for (size_t i = 0; i < n; ++i) {
+            threads.emplace_back([this] { worker(); });
+        }
+    }
+
+    BoundedTaskQueue(const BoundedTaskQueue&) = delete;
+    ~BoundedTaskQueue() override = default;
+
+    bool enqueue(std::function<void()> fn) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (max_queued > 0 && jobs.size() >= max_queued) {
+                metrics.rejected++;
+                return false;
+            }
+            jobs.emplace_back(std::move(fn), Clock::now());
+            metrics.depth = jobs.size();
+            metrics.peak_depth = std::max(metrics.peak_depth.load(), jobs.size());
+        }
+        metrics.accepted++;
+        cond.notify_one();
+        return true;
+    }
+
+    void shutdown() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            shutting_down = true;
+        }
+        cond.notify_all();
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+};
+
+// Admission control for one class of requests: at most max_concurrency running and
+// max_queue waiting; anything beyond that (or waiting longer than max_wait) gets a 429.
+class RequestLane {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::string name;
+    size_t max_concurrency;
+    size_t max_queue;
+    std::chrono::milliseconds max_wait;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t in_flight = 0;
+    size_t waiting = 0;
+
+    std::atomic<uint64_t> admitted{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> timed_out{0};
+    LatencyHistogram wait_us;
+    LatencyHistogram service_us;
+
+public:
+    RequestLane(std::string lane_name, size_t concurrency, size_t queue, std::chrono::milliseconds wait)
+        : name(std::move(lane_name)), max_concurrency(std::max<size_t>(concurrency, 1)),
+          max_queue(queue), max_wait(wait) {}
+
+    bool acquire() {
+        const auto queued_at = Clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (in_flight >= max_concurrency) {
+            if (waiting >= max_queue) {
+                rejected++;
+                return false;
+            }
+            waiting++;
+            const bool got_slot = cond.wait_until(lock, queued_at + max_wait,
+                                                  [this] { return in_flight < max_concurrency; });
+            waiting--;
+            if (!got_slot) {
+                timed_out++;
+                return false;
+            }
+        }
+
+        in_flight++;
+        admitted++;
+        wait_us.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - queued_at).count()));
+        return true;
+    }
+
+    void release(Clock::duration service_time) {
+        service_us.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(service_time).count()));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_flight--;
+        }
+        cond.notify_one();
+    }
+
+    // Rough time until the current backlog drains, for the Retry-After header
+    int retry_after_seconds() {
+        size_t backlog;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            backlog = in_flight + waiting;
+        }
+        const double drain_us = service_us.mean() * static_cast<double>(backlog) / static_cast<double>(max_concurrency);
+        return std::max(1, static_cast<int>(drain_us / 1e6 + 0.999));
+    }
+
+    const std::string& get_name() const {
+        return name;
+    }
+
+    json get_metrics() {
+        json metrics;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            metrics["in_flight"] = in_flight;
+            metrics["queue_depth"] = waiting;
+        }
+        metrics["max_concurrency"] = max_concurrency;
+        metrics["max_queue"] = max_queue;
+        metrics["admitted"] = admitted.load();
+        metrics["rejected"] = rejected.load();
+        metrics["timed_out"] = timed_out.load();
+        metrics["wait_ms"] = {
+            {"p50", wait_us.percentile(0.50) / 1000.0},
+            {"p99", wait_us.percentile(0.99) / 1000.0},
+            {"max", wait_us.max() / 1000.0}
+        };
+        metrics["service_ms"] = {
+            {"p50", service_us.percentile(0.50) / 1000.0},
+            {"p99", service_us.percentile(0.99) / 1000.0},
+            {"max", service_us.max() / 1000.0}
+        };
+        return metrics;
+    }
+};
+
+// Owns the connection queue metrics and the two lanes, and wraps route handlers
+class RequestExecutor {
+private:
+    ExecutorConfig config;
+    BoundedTaskQueue::Metrics queue_metrics;
+    RequestLane read_lane;
+    RequestLane mutation_lane;
+    RequestLane control_lane;
+
+    static ExecutorConfig normalize(ExecutorConfig cfg) {
+        cfg.worker_threads = std::max(cfg.worker_threads, RESERVED_READ_WORKERS + 2);
+        if (cfg.read_concurrency == 0) {
+            cfg.read_concurrency = cfg.worker_threads;
+        }
+        if (cfg.mutation_concurrency == 0) {
+            cfg.mutation_concurrency = std::thread::hardware_concurrency();
+        }
+        // Running + queued mutations and pauses each pin a worker; keep some for status/list/health.
+        // Pauses come out of the budget first so a start/stop backlog cannot crowd them out.
+        const size_t budget = cfg.worker_threads - RESERVED_READ_WORKERS;
+        cfg.control_concurrency = std::clamp<size_t>(cfg.control_concurrency, 1, budget - 1);
+        cfg.control_queue = std::min(cfg.control_queue, budget - 1 - cfg.control_concurrency);
+        const size_t mutation_budget = budget - cfg.control_concurrency - cfg.control_queue;
+        cfg.mutation_concurrency = std::clamp<size_t>(cfg.mutation_concurrency, 1, mutation_budget);
+        cfg.mutation_queue = std::min(cfg.mutation_queue, mutation_budget - cfg.mutation_concurrency);
+        return cfg;
+    }
+
+    static void reject(httplib::Response& res, RequestLane& lane) {
+        const int retry_after = lane.retry_after_seconds();
+        json error_response;
+        error_response["error"] = "Server busy";
+        error_response["lane"] = lane.get_name();
+        error_response["retry_after_seconds"] = retry_after;
+        res.status = 429;
+        res.set_header("Retry-After", std::to_string(retry_after));
+        res.set_content(error_response.dump(), "application/json");
+    }
+
+    // Works for plain httplib handlers and for RouteTrie handlers that also take captured params
+    template <typename Handler>
+    static auto wrap(RequestLane& lane, Handler handler) {
+        return [&lane, handler = std::move(handler)](const httplib::Request& req, httplib::Response& res,
+                                                     const auto&... params) {
+            if (!lane.acquire()) {
+                reject(res, lane);
+                return;
+            }
+            struct Release {
+                RequestLane& lane;
+                std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+                ~Release() { lane.release(std::chrono::steady_clock::now() - started); }
+            } release{lane};
+            handler(req, res, params...);
+        };
+    }
+
+public:
+    explicit RequestExecutor(const ExecutorConfig& cfg = ExecutorConfig())
+        : config(normalize(cfg)),
+          read_lane("read", config.read_concurrency, config.read_queue, config.max_lane_wait),
+          mutation_lane("mutation", config.mutation_concurrency, config.mutation_queue, config.max_lane_wait),
+          control_lane("control", config.control_concurrency, config.control_queue, config.max_lane_wait) {}
+
+    // The server owns the queue it creates; metrics live here so they outlive each listen()
+    void install(httplib::Server& server) {
+        server.new_task_queue = [this] {
+            return new BoundedTaskQueue(config.worker_threads, config.connection_backlog, queue_metrics);
+        };
+    }
+
+    // Cheap lookups: status, list, health
+    template <typename Handler>
+    auto read(Handler handler) {
+        return wrap(read_lane, std::move(handler));
+    }
+
+    // Expensive state changes: start, stop, calibrate
+    template <typename Handler>
+    auto mutation(Handler handler) {
+        return wrap(mutation_lane, std::move(handler));
+    }
+
+    // Quick state changes on a running stream: pause
+    template <typename Handler>
+    auto control(Handler handler) {
+        return wrap(control_lane, std::move(handler));
+    }
+
+    json get_metrics() {
+        json metrics;
+        metrics["connections"] = {
+            {"workers", config.worker_threads},
+            {"busy_workers", queue_metrics.busy_workers.load()},
+            {"queue_depth", queue_metrics.depth.load()},
+            {"peak_queue_depth", queue_metrics.peak_depth.load()},
+            {"max_queue", config.connection_backlog},
+            {"accepted", queue_metrics.accepted.load()},
+            {"rejected", queue_metrics.rejected.load()},
+            {"wait_ms", {
+                {"p50", queue_metrics.wait_us.percentile(0.50) / 1000.0},
+                {"p99", queue_metrics.wait_us.percentile(0.99) / 1000.0},
+                {"max", queue_metrics.wait_us.max() / 1000.0}
+            }}
+        };
+        metrics["lanes"] = {
+            {"read", read_lane.get_metrics()},
+            {"mutation", mutation_lane.get_metrics()},
+            {"control", control_lane.get_metrics()}
+        };
+        return metrics;
+    }
+};
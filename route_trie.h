@@ -0,0 +1,183 @@
+// route_trie.h - Startup-built path trie that dispatches API routes without std::regex
+#pragma once
+
+#include "third_party/httplib.h"
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <utility>
+
+// Captured ":name" segments, in pattern order. Views point into Request::path, which
+// outlives the handler call.
+struct RouteParams {
+    static constexpr size_t MAX_PARAMS = 4;
+
+    std::array<std::string_view, MAX_PARAMS> values{};
+    size_t count = 0;
+
+    std::string_view operator[](size_t i) const {
+        return i < count ? values[i] : std::string_view();
+    }
+};
+
+class RouteTrie {
+public:
+    using Handler = std::function<void(const httplib::Request&, httplib::Response&, const RouteParams&)>;
+
+    enum class Method {
+        GET,
+        POST,
+        PUT,
+        DELETE,
+        COUNT
+    };
+
+private:
+    struct Node {
+        // Static children are few per level (<= 3 here), a linear scan beats hashing
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> children;
+        std::unique_ptr<Node> param_child;
+        std::array<Handler, static_cast<size_t>(Method::COUNT)> handlers;
+    };
+
+    Node root;
+
+    static bool parse_method(const std::string& method, Method& out) {
+        switch (method.size()) {
+            case 3:
+                if (method == "GET") { out = Method::GET; return true; }
+                if (method == "PUT") { out = Method::PUT; return true; }
+                return false;
+            case 4:
+                if (method == "POST") { out = Method::POST; return true; }
+                // httplib strips the body for HEAD, same as its own routing
+                if (method == "HEAD") { out = Method::GET; return true; }
+                return false;
+            case 6:
+                if (method == "DELETE") { out = Method::DELETE; return true; }
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    // Splits "/a/b/c" one segment at a time; returns false once the path is exhausted
+    static bool next_segment(std::string_view& rest, std::string_view& segment) {
+        if (rest.empty() || rest.front() != '/') return false;
+        rest.remove_prefix(1);
+        const size_t slash = rest.find('/');
+        segment = rest.substr(0, slash);
+        rest = slash == std::string_view::npos ? std::string_view() : rest.substr(slash);
+        return true;
+    }
+
+public:
+    // Pattern segments are literals or ":name" captures, e.g. "/v1/stream/:id/start".
+    // A capture matches one non-empty segment, same as the "([^/]+)" regexes it replaces.
+    void add(Method method, std::string_view pattern, Handler handler) {
+        Node* node = &root;
+        std::string_view rest = pattern;
+        std::string_view segment;
+
+        while (next_segment(rest, segment)) {
+            if (!segment.empty() && segment.front() == ':') {
+                if (!node->param_child) node->param_child = std::make_unique<Node>();
+                node = node->param_child.get();
+                continue;
+            }
+
+            Node* child = nullptr;
+            for (auto& [name, next] : node->children) {
+                if (name == segment) {
+                    child = next.get();
+                    break;
+                }
+            }
+            if (!child) {
+                node->children.emplace_back(std::string(segment), std::make_unique<Node>());
+                child = node->children.back().second.get();
+            }
+            node = child;
+        }
+
+        node->handlers[static_cast<size_t>(method)] = std::move(handler);
+    }
+
+    void Get(std::string_view pattern, Handler handler) { add(Method::GET, pattern, std::move(handler)); }
+    void Post(std::string_view pattern, Handler handler) { add(Method::POST, pattern, std::move(handler)); }
+    void Put(std::string_view pattern, Handler handler) { add(Method::PUT, pattern, std::move(handler)); }
+    void Delete(std::string_view pattern, Handler handler) { add(Method::DELETE, pattern, std::move(handler)); }
+
+    // Finds the handler for method + path; literal segments win over captures
+    const Handler* match(const std::string& method, std::string_view path, RouteParams& params) const {
+        Method m;
+        if (!parse_method(method, m)) return nullptr;
+
+        const Node* node = &root;
+        std::string_view rest = path;
+        std::string_view segment;
+        params.count = 0;
+
+        while (next_segment(rest, segment)) {
+            const Node* next = nullptr;
+            for (const auto& [name, child] : node->children) {
+                if (name == segment) {
+                    next = child.get();
+                    break;
+                }
+            }
+            if (!next && node->param_child && !segment.empty() && params.count < RouteParams::MAX_PARAMS) {
+                params.values[params.count++] = segment;
+                next = node->param_child.get();
+            }
+            if (!next) return nullptr;
+            node = next;
+        }
+
+        const Handler& handler = node->handlers[static_cast<size_t>(m)];
+        return handler ? &handler : nullptr;
+    }
+
+    // True if a route handled the request
+    bool dispatch(const httplib::Request& req, httplib::Response& res) const {
+        RouteParams params;
+        const Handler* handler = match(req.method, req.path, params);
+        if (!handler) return false;
+        (*handler)(req, res, params);
+        return true;
+    }
+
+    // Serves every route from the pre-routing hook so httplib's regex handler lists are never
+    // walked. Requests carrying a body must be read by httplib first, so those (and misses) fall
+    // through to one catch-all per method that dispatches here after the body is in req.body.
+    void install(httplib::Server& server, httplib::Headers common_headers) {
+        server.set_pre_routing_handler([this, common_headers = std::move(common_headers)](
+                                           const httplib::Request& req, httplib::Response& res) {
+            res.headers = common_headers;
+
+            // CORS preflight for any path
+            if (req.method == "OPTIONS") {
+                return httplib::Server::HandlerResponse::Handled;
+            }
+            if (req.get_header_value_u64("Content-Length") > 0 ||
+                httplib::detail::is_chunked_transfer_encoding(req.headers)) {
+                return httplib::Server::HandlerResponse::Unhandled;
+            }
+            return dispatch(req, res) ? httplib::Server::HandlerResponse::Handled
+                                      : httplib::Server::HandlerResponse::Unhandled;
+        });
+
+        auto fallback = [this](const httplib::Request& req, httplib::Response& res) {
+            if (!dispatch(req, res)) {
+                res.status = 404;
+            }
+        };
+        server.Get(".*", fallback);
+        server.Post(".*", fallback);
+        server.Put(".*", fallback);
+        server.Delete(".*", fallback);
+    }
+};
@@ -0,0 +1,170 @@
+// shutdown_coordinator.h - SIGINT/SIGTERM wake-up and a parallel, deadline-bounded drain of all streams
+#pragma once
+
+#include "third_party/json.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <csignal>
+#include <pthread.h>
+
+using json = nlohmann::json;
+
+// Singleton Shutdown Coordinator
+class ShutdownCoordinator {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Stops and finalizes one stream, force-stopping its output at stop_by; returns "finalized",
+    // "forced" or "not_recording"
+    using DrainTask = std::function<std::string(Clock::time_point stop_by)>;
+
+private:
+    static inline std::unique_ptr<ShutdownCoordinator> instance;
+    static inline std::mutex instance_mutex;
+
+    // launchd sends SIGKILL ExitTimeOut (20 s in the plist) after SIGTERM; leave room for OBS teardown
+    std::chrono::milliseconds drain_timeout{10000};
+    std::atomic<bool> draining{false};
+    Clock::time_point drain_started;
+    Clock::time_point drain_deadline;
+    sigset_t signals;
+
+    struct DrainResult {
+        std::string stream_id;
+        std::string outcome = "timed_out";
+        double elapsed_ms = 0.0;
+    };
+
+    // Shared with the drain threads, which may outlive drain() if they miss the deadline
+    struct DrainState {
+        std::mutex mutex;
+        std::condition_variable done;
+        std::vector<DrainResult> results;
+        size_t remaining = 0;
+    };
+
+    ShutdownCoordinator() {
+        if (const char* timeout = std::getenv("SCREENRECORDER_DRAIN_TIMEOUT_MS")) {
+            drain_timeout = std::chrono::milliseconds(std::clamp(std::atoi(timeout), 1000, 60000));
+        }
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+    }
+
+    static double ms_between(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+public:
+    static ShutdownCoordinator* getInstance() {
+        std::lock_guard<std::mutex> lock(instance_mutex);
+        if (!instance) {
+            instance = std::unique_ptr<ShutdownCoordinator>(new ShutdownCoordinator());
+        }
+        return instance.get();
+    }
+
+    // Call before any other thread exists: every thread inherits the blocked mask, so the
+    // signals stay pending until wait_for_signal() picks them up instead of interrupting OBS
+    // or HTTP threads (and the handler no longer has to be async-signal-safe)
+    void block_signals() {
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    }
+
+    // Sleeps until SIGINT or SIGTERM arrives; returns the signal number
+    int wait_for_signal() {
+        int received = 0;
+        while (sigwait(&signals, &received) != 0) {
+        }
+        return received;
+    }
+
+    // From here on the start route refuses new streams; the drain deadline starts counting now
+    void begin_drain() {
+        drain_started = Clock::now();
+        drain_deadline = drain_started + drain_timeout;
+        draining = true;
+    }
+
+    bool is_draining() const {
+        return draining;
+    }
+
+    std::chrono::milliseconds get_drain_timeout() const {
+        return drain_timeout;
+    }
+
+    // Outputs still running this close to the deadline are force-stopped, leaving time for cleanup
+    Clock::time_point get_stop_deadline() const {
+        return drain_deadline - std::min(drain_timeout / 4, std::chrono::milliseconds(1500));
+    }
+
+    // Runs every task on its own thread and waits for all of them or the deadline, whichever is
+    // first. A task still running at the deadline is reported as "timed_out" and left detached.
+    json drain(std::vector<std::pair<std::string, DrainTask>> tasks) {
+        const Clock::time_point started = drain_started;
+        const Clock::time_point deadline = drain_deadline;
+        const Clock::time_point stop_by = get_stop_deadline();
+        auto state = std::make_shared<DrainState>();
+        state->results.resize(tasks.size());
+        state->remaining = tasks.size();
+
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            state->results[i].stream_id = tasks[i].first;
+            std::thread([state, i, task = std::move(tasks[i].second), started, stop_by]() {
+                std::string outcome;
+                try {
+                    outcome = task(stop_by);
+                } catch (const std::exception& e) {
+                    std::cerr << "Drain failed for stream " << state->results[i].stream_id << ": " << e.what() << std::endl;
+                    outcome = "failed";
+                }
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->results[i].outcome = outcome;
+                state->results[i].elapsed_ms = ms_between(started, Clock::now());
+                state->remaining--;
+                state->done.notify_all();
+            }).detach();
+        }
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait_until(lock, deadline, [&] { return state->remaining == 0; });
+
+        json report;
+        report["drain_timeout_ms"] = drain_timeout.count();
+        report["elapsed_ms"] = ms_between(started, Clock::now());
+        report["complete"] = state->remaining == 0;
+        report["streams"] = json::array();
+        std::map<std::string, int> counts{{"finalized", 0}, {"forced", 0}, {"not_recording", 0},
+                                          {"failed", 0}, {"timed_out", 0}};
+        for (const auto& r : state->results) {
+            counts[r.outcome]++;
+            json stream = {{"stream_id", r.stream_id}, {"outcome", r.outcome}};
+            if (r.outcome != "timed_out") stream["elapsed_ms"] = r.elapsed_ms;
+            report["streams"].push_back(stream);
+        }
+        for (const auto& c : counts) report[c.first] = c.second;
+        return report;
+    }
+
+    // Logged and left next to the recordings so the last shutdown can be checked after a restart
+    static void write_report(const json& report, const std::string& path = "/tmp/3clogic_shutdown_report.json") {
+        std::cout << "Drain report: " << report.dump() << std::endl;
+        std::ofstream file(path, std::ios::trunc);
+        if (file) {
+            file << report.dump(2) << std::endl;
+        }
+    }
+};
@@ -0,0 +1,504 @@
+// egress_probe.cpp - UDP MPEG-TS receiver for the live egress: continuity-counter and PTS-gap loss,
+// PTS-vs-arrival delay and jitter, next to the recorder's own glass-to-encoder latency.
+// --loopback runs the real recorder in-process against the OBS fake (fake_obs/), whose
+// ffmpeg_mpegts_muxer sends real TS datagrams, and starts a stream whose LiveEgress sends them
+// through a relay that injects loss/delay/jitter. SRT/RIST listeners are probed by relaying them
+// to UDP first, e.g.
+//   srt-live-transmit "srt://:9000?mode=listener" udp://127.0.0.1:9001
+//   ristreceiver -i "rist://@:9000" -o udp://127.0.0.1:9001
+#define SCREENRECORDER_NO_MAIN
+#include "../main.cpp"
+#include "fake_obs/obs_fake.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t TS_PACKET_SIZE = 188;
+static constexpr uint64_t PTS_MASK = (1ULL << 33) - 1;
+
+struct ProbeOptions {
+    std::string host = "127.0.0.1";
+    int port = 9001;
+    int duration_s = 30;
+    bool loopback = false;
+    double loss_percent = 0.0;
+    int delay_ms = 0;
+    int jitter_ms = 0;
+    std::string api;        // host:port of the recorder, to pull server-side glass-to-encoder latency
+    std::string stream_id;
+    std::string output;
+};
+
+static void usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [options]\n"
+              << "  --listen HOST:PORT    UDP address to receive MPEG-TS on (default 127.0.0.1:9001)\n"
+              << "  --duration SECONDS    measurement window (default 30)\n"
+              << "  --loopback            run the recorder in-process on the OBS fake, egress to --listen\n"
+              << "  --loss PERCENT        loopback relay datagram loss (default 0)\n"
+              << "  --delay-ms MS         loopback relay one-way delay (default 0)\n"
+              << "  --jitter-ms MS        loopback relay uniform extra delay 0..MS (default 0)\n"
+              << "  --api HOST:PORT       recorder API, combined with --stream for glass-to-encoder latency\n"
+              << "  --stream ID           stream id whose egress is being probed (loopback: egress-probe)\n"
+              << "  --output FILE         also write the JSON report to FILE\n";
+}
+
+static bool split_host_port(const std::string& value, std::string& host, int& port) {
+    const size_t colon = value.rfind(':');
+    if (colon == std::string::npos) return false;
+    host = value.substr(0, colon);
+    port = std::atoi(value.c_str() + colon + 1);
+    return !host.empty() && port > 0;
+}
+
+static bool parse_args(int argc, char* argv[], ProbeOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* value = nullptr;
+
+        if (arg == "--loopback") {
+            options.loopback = true;
+            continue;
+        }
+        if (!(value = next())) return false;
+
+        if (arg == "--listen") {
+            if (!split_host_port(value, options.host, options.port)) return false;
+        } else if (arg == "--duration") {
+            options.duration_s = std::atoi(value);
+        } else if (arg == "--loss") {
+            options.loss_percent = std::atof(value);
+        } else if (arg == "--delay-ms") {
+            options.delay_ms = std::atoi(value);
+        } else if (arg == "--jitter-ms") {
+            options.jitter_ms = std::atoi(value);
+        } else if (arg == "--api") {
+            options.api = value;
+        } else if (arg == "--stream") {
+            options.stream_id = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            return false;
+        }
+    }
+    return options.duration_s > 0;
+}
+
+// Receiver-side accounting for one MPEG-TS stream
+class TsAnalyzer {
+private:
+    struct Frame {
+        uint64_t arrival_ns = 0;    // when the datagram with the PES header arrived
+        int64_t pts_us = 0;         // unwrapped PES PTS
+    };
+
+    struct PidState {
+        int last_cc = -1;
+        uint64_t packets = 0;
+        uint64_t lost = 0;
+    };
+
+    std::map<uint16_t, PidState> pids;
+    int video_pid = -1;
+    uint64_t last_pts = 0;
+    uint64_t pts_wraps = 0;     // the 33-bit PTS wraps every ~26.5 h of stream time
+    std::vector<Frame> frames;  // per video PES, in arrival order
+
+public:
+    uint64_t datagrams = 0;
+    uint64_t bytes = 0;
+    uint64_t ts_packets = 0;
+    uint64_t sync_errors = 0;
+
+    void on_datagram(const uint8_t* data, size_t size, uint64_t arrival_ns) {
+        datagrams++;
+        bytes += size;
+        for (size_t off = 0; off + TS_PACKET_SIZE <= size; off += TS_PACKET_SIZE) {
+            on_packet(data + off, arrival_ns);
+        }
+    }
+
+    void on_packet(const uint8_t* p, uint64_t arrival_ns) {
+        ts_packets++;
+        if (p[0] != 0x47) {
+            sync_errors++;
+            return;
+        }
+
+        const uint16_t pid = static_cast<uint16_t>(((p[1] & 0x1F) << 8) | p[2]);
+        if (pid == 0x1FFF) return; // null packets carry no CC
+
+        const bool payload_start = p[1] & 0x40;
+        const int adaptation = (p[3] >> 4) & 0x3;
+        const int cc = p[3] & 0x0F;
+        size_t payload = 4;
+
+        PidState& state = pids[pid];
+        state.packets++;
+
+        bool discontinuity = false;
+        if (adaptation & 0x2) {
+            const size_t length = p[4];
+            discontinuity = length > 0 && (p[5] & 0x80);
+            payload = 5 + length;
+        }
+
+        // CC only advances on packets with payload; a repeated CC is a legal duplicate
+        if (adaptation & 0x1) {
+            if (state.last_cc >= 0 && !discontinuity && cc != state.last_cc) {
+                state.lost += static_cast<uint64_t>((cc - state.last_cc - 1) & 0x0F);
+            }
+            state.last_cc = cc;
+        }
+
+        if (!payload_start || !(adaptation & 0x1) || payload + 14 > TS_PACKET_SIZE) return;
+
+        const uint8_t* pes = p + payload;
+        if (pes[0] != 0 || pes[1] != 0 || pes[2] != 1) return;
+        if ((pes[3] & 0xF0) != 0xE0) return; // video elementary stream
+        if (video_pid < 0) video_pid = pid;
+        if (pid != video_pid || !(pes[7] & 0x80)) return;
+
+        const uint64_t pts = (static_cast<uint64_t>(pes[9] & 0x0E) << 29) |
+                             (static_cast<uint64_t>(pes[10]) << 22) |
+                             (static_cast<uint64_t>(pes[11] & 0xFE) << 14) |
+                             (static_cast<uint64_t>(pes[12]) << 7) |
+                             (static_cast<uint64_t>(pes[13]) >> 1);
+        // Unwrap: B-frames step back a little, a wrap steps back by most of the range, and a
+        // reordered frame from just before the wrap steps forward by most of it
+        uint64_t wraps = pts_wraps;
+        if (!frames.empty() && pts + (PTS_MASK >> 1) < last_pts) {
+            wraps = ++pts_wraps;
+            last_pts = pts;
+        } else if (pts_wraps > 0 && last_pts + (PTS_MASK >> 1) < pts) {
+            wraps = pts_wraps - 1;
+        } else {
+            last_pts = pts;
+        }
+
+        const uint64_t unwrapped = pts + wraps * (PTS_MASK + 1);
+        frames.push_back({arrival_ns, static_cast<int64_t>(unwrapped * 1000 / 90)});
+    }
+
+    uint64_t lost_packets() const {
+        uint64_t lost = 0;
+        for (const auto& [pid, state] : pids) lost += state.lost;
+        return lost;
+    }
+
+    // PTS has an unknown origin (the muxer's), so arrival - PTS is only meaningful as the delay
+    // above the fastest frame: queueing and jitter, not the constant transport offset
+    json report(uint64_t elapsed_us) const {
+        LatencyHistogram delay_us;
+        int64_t min_offset_us = 0;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            const int64_t offset = static_cast<int64_t>(frames[i].arrival_ns / 1000) - frames[i].pts_us;
+            if (i == 0 || offset < min_offset_us) min_offset_us = offset;
+        }
+        for (const Frame& frame : frames) {
+            const int64_t offset = static_cast<int64_t>(frame.arrival_ns / 1000) - frame.pts_us;
+            delay_us.record(static_cast<uint64_t>(offset - min_offset_us));
+        }
+
+        // Frames whose PES header never arrived show up as PTS gaps of more than one frame interval
+        std::vector<int64_t> pts;
+        for (const Frame& frame : frames) pts.push_back(frame.pts_us);
+        std::sort(pts.begin(), pts.end());
+        std::map<int64_t, size_t> deltas;
+        for (size_t i = 1; i < pts.size(); ++i) {
+            if (pts[i] > pts[i - 1]) deltas[pts[i] - pts[i - 1]]++;
+        }
+        int64_t interval_us = 0;
+        size_t interval_votes = 0;
+        for (const auto& [delta, votes] : deltas) {
+            if (votes > interval_votes) {
+                interval_us = delta;
+                interval_votes = votes;
+            }
+        }
+        uint64_t frames_missing = 0;
+        for (size_t i = 1; interval_us > 0 && i < pts.size(); ++i) {
+            const int64_t gap = std::llround(static_cast<double>(pts[i] - pts[i - 1]) / static_cast<double>(interval_us));
+            if (gap > 1) frames_missing += static_cast<uint64_t>(gap - 1);
+        }
+
+        const uint64_t lost = lost_packets();
+        json result;
+        result["datagrams"] = datagrams;
+        result["bytes"] = bytes;
+        result["bitrate_kbps"] = elapsed_us ? static_cast<double>(bytes) * 8 * 1000 / static_cast<double>(elapsed_us) : 0.0;
+        result["ts_packets"] = ts_packets;
+        result["ts_packets_lost"] = lost;
+        result["loss_percent"] = ts_packets + lost ? 100.0 * static_cast<double>(lost) / static_cast<double>(ts_packets + lost) : 0.0;
+        result["ts_loss_note"] = "continuity counters wrap at 16, so a burst of 16 or more lost packets on one PID "
+                                 "is undercounted by a multiple of 16; video_frames_missing counts whole frames from PTS gaps";
+        result["sync_errors"] = sync_errors;
+        result["video_pid"] = video_pid;
+        result["video_frames"] = frames.size();
+        result["video_frame_interval_ms"] = interval_us / 1000.0;
+        result["video_frames_missing"] = frames_missing;
+        result["relative_delay_ms"] = {
+            {"p50", delay_us.percentile(0.50) / 1000.0},
+            {"p99", delay_us.percentile(0.99) / 1000.0},
+            {"p999", delay_us.percentile(0.999) / 1000.0},
+            {"max", delay_us.max() / 1000.0}
+        };
+        result["jitter_ms"] = (delay_us.percentile(0.99) - delay_us.percentile(0.50)) / 1000.0;
+        return result;
+    }
+};
+
+// Impairment relay for --loopback: the in-process recorder's egress sends here, and datagrams
+// are dropped/delayed before being forwarded to --listen
+class LoopbackRelay {
+private:
+    const ProbeOptions& options;
+    std::atomic<bool>& running;
+    std::mt19937_64 rng{0x5eed};
+    int fd = -1;
+
+public:
+    uint64_t received_datagrams = 0;
+    uint64_t forwarded_datagrams = 0;
+    uint64_t dropped_datagrams = 0;
+
+    LoopbackRelay(const ProbeOptions& opts, std::atomic<bool>& run) : options(opts), running(run) {}
+
+    // Binds an ephemeral loopback port for the egress URL; -1 on failure
+    int bind_port() {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addr);
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+            return -1;
+        }
+        const int rcvbuf = 8 * 1024 * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        return ntohs(addr.sin_port);
+    }
+
+    void run() {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(options.port));
+        inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr);
+
+        std::uniform_real_distribution<double> loss(0.0, 100.0);
+        std::uniform_int_distribution<int> jitter(0, std::max(options.jitter_ms, 0) * 1000);
+
+        // Datagrams waiting out their injected delay, keyed by release time
+        std::multimap<Clock::time_point, std::vector<uint8_t>> in_flight;
+        auto last_release = Clock::now();
+        std::vector<uint8_t> buffer(65536);
+
+        while (running) {
+            int timeout_ms = 10;
+            if (!in_flight.empty()) {
+                const auto until = std::chrono::duration_cast<std::chrono::milliseconds>(in_flight.begin()->first - Clock::now());
+                timeout_ms = static_cast<int>(std::clamp<int64_t>(until.count(), 0, timeout_ms));
+            }
+            pollfd readable{fd, POLLIN, 0};
+            if (poll(&readable, 1, timeout_ms) > 0) {
+                const ssize_t n = recv(fd, buffer.data(), buffer.size(), 0);
+                if (n > 0) {
+                    received_datagrams++;
+                    if (loss(rng) < options.loss_percent) {
+                        dropped_datagrams++;
+                    } else {
+                        // FIFO like a real queue: jitter varies delay without reordering datagrams
+                        const auto now = Clock::now();
+                        const auto release = std::max(last_release, now + std::chrono::milliseconds(options.delay_ms) +
+                                                                        std::chrono::microseconds(jitter(rng)));
+                        last_release = release;
+                        in_flight.emplace(release, std::vector<uint8_t>(buffer.begin(), buffer.begin() + n));
+                    }
+                }
+            }
+
+            while (!in_flight.empty() && in_flight.begin()->first <= Clock::now()) {
+                const auto& datagram = in_flight.begin()->second;
+                sendto(fd, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+                forwarded_datagrams++;
+                in_flight.erase(in_flight.begin());
+            }
+        }
+        close(fd);
+    }
+};
+
+// Loopback port nothing is listening on, for RecordingManager::start_server()
+static int free_port() {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    int port = -1;
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+        getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) == 0) {
+        port = ntohs(addr.sin_port);
+    }
+    close(fd);
+    return port;
+}
+
+// Server-side half of the latency: frame tick -> encoded packet, from the recorder status
+static json fetch_encoder_latency(const ProbeOptions& options) {
+    std::string host;
+    int port = 0;
+    if (options.api.empty() || options.stream_id.empty() || !split_host_port(options.api, host, port)) {
+        return nullptr;
+    }
+
+    httplib::Client client(host, port);
+    client.set_connection_timeout(2, 0);
+    const auto res = client.Get("/v1/stream/" + options.stream_id + "/status");
+    if (!res || res->status != 200) return nullptr;
+
+    const json status = json::parse(res->body, nullptr, false);
+    if (!status.is_object() || !status.contains("egress")) return nullptr;
+    return status["egress"];
+}
+
+int main(int argc, char* argv[]) {
+    ProbeOptions options;
+    if (!parse_args(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr) != 1 ||
+        bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Failed to bind UDP " << options.host << ":" << options.port << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    const int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    timeval timeout{0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::atomic<bool> running{true};
+    LoopbackRelay relay(options, running);
+    std::thread relay_thread;
+    std::unique_ptr<RecordingManager> manager;
+    std::thread server_thread;
+    // The recorder logs to stdout, which carries the report
+    std::streambuf* const stdout_buffer = std::cout.rdbuf();
+    if (options.loopback) {
+        const int relay_port = relay.bind_port();
+        const int api_port = free_port();
+        if (relay_port < 0 || api_port < 0) {
+            std::cerr << "No free loopback port for the relay or recorder API" << std::endl;
+            return 1;
+        }
+        relay_thread = std::thread([&relay] { relay.run(); });
+        std::cout.rdbuf(std::cerr.rdbuf());
+
+        // The startup benchmark would otherwise measure the fake for over a minute
+        EncoderCalibrator::getInstance()->cancel();
+        manager = std::make_unique<RecordingManager>();
+        manager->wait_for_calibration();
+        server_thread = std::thread([&manager, api_port] { manager->start_server("127.0.0.1", api_port); });
+        options.api = "127.0.0.1:" + std::to_string(api_port);
+        if (options.stream_id.empty()) options.stream_id = "egress-probe";
+
+        httplib::Client client("127.0.0.1", api_port);
+        for (int attempt = 0; attempt < 100 && !client.Get("/health"); ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        const json body = {{"egress", {{"url", "udp://127.0.0.1:" + std::to_string(relay_port)}}}};
+        const auto started = client.Post("/v1/stream/" + options.stream_id + "/start", body.dump(), "application/json");
+        if (!started || started->status != 200) {
+            std::cerr << "Loopback recorder failed to start " << options.stream_id << ": "
+                      << (started ? started->body : httplib::to_string(started.error())) << std::endl;
+            options.duration_s = 0;
+        }
+    }
+
+    std::cerr << "Listening for MPEG-TS on udp://" << options.host << ":" << options.port
+              << " for " << options.duration_s << "s" << (options.loopback ? " (in-process recorder)" : "") << std::endl;
+
+    TsAnalyzer analyzer;
+    std::vector<uint8_t> buffer(65536);
+    const auto deadline = Clock::now() + std::chrono::seconds(options.duration_s);
+    uint64_t first_arrival = 0;
+    uint64_t last_arrival = 0;
+
+    while (Clock::now() < deadline) {
+        const ssize_t n = recv(fd, buffer.data(), buffer.size(), 0);
+        if (n <= 0) continue;
+        last_arrival = os_gettime_ns();
+        if (!first_arrival) first_arrival = last_arrival;
+        analyzer.on_datagram(buffer.data(), static_cast<size_t>(n), last_arrival);
+    }
+    close(fd);
+
+    json report;
+    report["listen"] = options.host + ":" + std::to_string(options.port);
+    report["duration_seconds"] = options.duration_s;
+    report["receiver"] = analyzer.report((last_arrival - first_arrival) / 1000);
+
+    // Reported side by side, not summed: p99 encoder latency plus p99 receiver delay is not the
+    // p99 of their sum, and the PTS origin is the muxer's, so frames cannot be paired across the two
+    const json egress = fetch_encoder_latency(options);
+    if (!egress.is_null()) {
+        report["server_egress"] = egress;
+    }
+
+    running = false;
+    if (manager) {
+        httplib::Client client("127.0.0.1", std::stoi(options.api.substr(options.api.rfind(':') + 1)));
+        client.Delete("/v1/stream/" + options.stream_id + "/stop");
+        manager->stop_server();
+        server_thread.join();
+        manager.reset();
+        OBSCore::getInstance()->shutdown();
+        std::cout.rdbuf(stdout_buffer);
+    }
+    if (relay_thread.joinable()) relay_thread.join();
+
+    if (options.loopback) {
+        report["relay"] = {
+            {"loss_percent", options.loss_percent},
+            {"delay_ms", options.delay_ms},
+            {"jitter_ms", options.jitter_ms},
+            {"received_datagrams", relay.received_datagrams},
+            {"forwarded_datagrams", relay.forwarded_datagrams},
+            {"dropped_datagrams", relay.dropped_datagrams}
+        };
+    }
+
+    std::cout << report.dump(2) << std::endl;
+    if (!options.output.empty()) {
+        std::ofstream(options.output) << report.dump(2) << std::endl;
+    }
+    return 0;
+}
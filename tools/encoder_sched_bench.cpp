@@ -0,0 +1,255 @@
+// encoder_sched_bench.cpp - Free-for-all encoder threads vs CoreScheduler budgets on a synthetic load.
+// Each simulated encoder splits a fixed CPU cost per frame across its worker threads (as x264
+// frame/slice threads do) and must finish within two frame intervals; a render thread and an
+// HTTP thread wake on a fixed cadence and measure how late they get to run.
+#include "../third_party/json.hpp"
+#include "../core_scheduler.h"
+#include "../latency_histogram.h"
+#include <sys/resource.h>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <time.h>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    int streams = 8;
+    int fps = 30;
+    int duration_s = 10;
+    double load = 0.8;          // total encoder demand as a fraction of the non-reserved cores
+    int reserved = 2;
+};
+
+static uint64_t thread_cpu_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Burns this much CPU time (not wall time), so contention stretches it like real encoding
+static void burn_cpu(uint64_t ns) {
+    const uint64_t end = thread_cpu_ns() + ns;
+    volatile uint64_t x = 0;
+    while (thread_cpu_ns() < end) {
+        for (int i = 0; i < 2000; ++i) x += i;
+    }
+}
+
+static void pin_current_thread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    if (cpus.empty()) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpus;
+#endif
+}
+
+class SyntheticEncoder {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_cond;
+    std::condition_variable done_cond;
+    uint64_t generation = 0;
+    int remaining = 0;
+    bool stopping = false;
+    uint64_t chunk_ns;
+
+    void worker(std::vector<int> cpus) {
+        pin_current_thread(cpus);
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_cond.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            burn_cpu(chunk_ns);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--remaining == 0) done_cond.notify_one();
+            }
+        }
+    }
+
+public:
+    uint64_t frames = 0;
+    uint64_t late = 0;
+    uint64_t skipped = 0;
+    LatencyHistogram encode_us;
+
+    SyntheticEncoder(int threads, uint64_t frame_cpu_ns, const std::vector<int>& cpus)
+        : chunk_ns(frame_cpu_ns / static_cast<uint64_t>(std::max(threads, 1))) {
+        for (int i = 0; i < std::max(threads, 1); ++i) {
+            workers.emplace_back([this, cpus] { worker(cpus); });
+        }
+    }
+
+    ~SyntheticEncoder() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_cond.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    // Frame clock: like the OBS video thread, frames that come due while encoding are skipped
+    void run(std::atomic<bool>& running, std::chrono::nanoseconds interval) {
+        auto next = Clock::now();
+        while (running) {
+            std::this_thread::sleep_until(next);
+            const auto started = Clock::now();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                remaining = static_cast<int>(workers.size());
+                generation++;
+                work_cond.notify_all();
+                done_cond.wait(lock, [&] { return remaining == 0; });
+            }
+            const auto elapsed = Clock::now() - started;
+            encode_us.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+            frames++;
+            if (elapsed > 2 * interval) late++;
+
+            next += interval;
+            while (next + interval < Clock::now()) {
+                next += interval;
+                skipped++;
+            }
+        }
+    }
+};
+
+// Wakes every period, does a little work and records how late the wake-up was
+static void cadence_thread(std::atomic<bool>& running, std::chrono::microseconds period, uint64_t work_ns,
+                           LatencyHistogram& lateness_us, const std::vector<int>& cpus) {
+    pin_current_thread(cpus);
+    auto next = Clock::now() + period;
+    while (running) {
+        std::this_thread::sleep_until(next);
+        const auto woke = Clock::now();
+        lateness_us.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(woke - next).count()));
+        burn_cpu(work_ns);
+        next += period;
+        if (next < Clock::now()) next = Clock::now() + period;
+    }
+}
+
+static json run_mode(const std::string& mode, const BenchOptions& options) {
+    const int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const auto interval = std::chrono::nanoseconds(1000000000LL / options.fps);
+    const int encoder_cores = std::max(1, cores - options.reserved);
+    const uint64_t frame_cpu_ns = static_cast<uint64_t>(options.load * encoder_cores * static_cast<double>(interval.count())
+                                                        / options.streams);
+
+    std::vector<CoreAssignment> assignments;
+    std::vector<int> reserved_cpus;
+    if (mode == "budget") {
+        assignments = CoreScheduler::plan(cores, options.reserved, static_cast<size_t>(options.streams), true);
+        for (int c = 0; c < std::min(options.reserved, cores); ++c) reserved_cpus.push_back(c);
+    } else {
+        // x264's own default with threads=0 is 1.5x logical cores per encoder, unpinned
+        assignments.assign(static_cast<size_t>(options.streams), CoreAssignment{cores * 3 / 2, {}});
+    }
+
+    rusage usage_before;
+    getrusage(RUSAGE_SELF, &usage_before);
+
+    std::atomic<bool> running{true};
+    std::vector<std::unique_ptr<SyntheticEncoder>> encoders;
+    for (const auto& a : assignments) {
+        encoders.push_back(std::make_unique<SyntheticEncoder>(a.threads, frame_cpu_ns, a.cpus));
+    }
+
+    LatencyHistogram render_late_us;
+    LatencyHistogram http_late_us;
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] { cadence_thread(running, std::chrono::duration_cast<std::chrono::microseconds>(interval),
+                                              2000000, render_late_us, reserved_cpus); });
+    threads.emplace_back([&] { cadence_thread(running, std::chrono::microseconds(5000), 100000, http_late_us, reserved_cpus); });
+    for (auto& e : encoders) {
+        SyntheticEncoder* encoder = e.get();
+        threads.emplace_back([&running, encoder, interval] { encoder->run(running, interval); });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(options.duration_s));
+    running = false;
+    for (auto& t : threads) t.join();
+
+    rusage usage_after;
+    getrusage(RUSAGE_SELF, &usage_after);
+
+    uint64_t frames = 0, late = 0, skipped = 0;
+    LatencyHistogram encode_us;
+    for (const auto& e : encoders) {
+        frames += e->frames;
+        late += e->late;
+        skipped += e->skipped;
+        encode_us.record(e->encode_us.percentile(0.99));
+    }
+    const uint64_t expected = static_cast<uint64_t>(options.streams) * options.fps * options.duration_s;
+
+    json result;
+    result["mode"] = mode;
+    result["encoder_threads_per_stream"] = assignments.empty() ? 0 : assignments[0].threads;
+    result["frames_encoded"] = frames;
+    result["frames_expected"] = expected;
+    result["frames_dropped"] = skipped + late;
+    result["drop_percent"] = expected ? 100.0 * static_cast<double>(skipped + late) / static_cast<double>(expected) : 0.0;
+    result["throughput_fps"] = static_cast<double>(frames - late) / options.duration_s;
+    result["worst_stream_encode_p99_ms"] = encode_us.max() / 1000.0;
+    result["render_wake_late_ms"] = {{"p50", render_late_us.percentile(0.5) / 1000.0},
+                                     {"p99", render_late_us.percentile(0.99) / 1000.0},
+                                     {"max", render_late_us.max() / 1000.0}};
+    result["http_wake_late_ms"] = {{"p50", http_late_us.percentile(0.5) / 1000.0},
+                                   {"p99", http_late_us.percentile(0.99) / 1000.0},
+                                   {"max", http_late_us.max() / 1000.0}};
+    result["involuntary_context_switches"] = usage_after.ru_nivcsw - usage_before.ru_nivcsw;
+    result["voluntary_context_switches"] = usage_after.ru_nvcsw - usage_before.ru_nvcsw;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    const auto usage = [&]() {
+        std::cerr << "Usage: " << argv[0] << " [--streams N] [--fps N] [--duration S] [--load 0.8] [--reserved N]" << std::endl;
+        return 2;
+    };
+    // Every flag takes a value; a lone or trailing one (--help included) is a usage error
+    for (int i = 1; i < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) return usage();
+        if (arg == "--streams") options.streams = std::atoi(argv[i + 1]);
+        else if (arg == "--fps") options.fps = std::atoi(argv[i + 1]);
+        else if (arg == "--duration") options.duration_s = std::atoi(argv[i + 1]);
+        else if (arg == "--load") options.load = std::atof(argv[i + 1]);
+        else if (arg == "--reserved") options.reserved = std::atoi(argv[i + 1]);
+        else return usage();
+    }
+    if (options.streams <= 0 || options.fps <= 0 || options.duration_s <= 0 || options.load <= 0) return usage();
+
+    json result;
+    result["cores"] = std::thread::hardware_concurrency();
+    result["streams"] = options.streams;
+    result["fps"] = options.fps;
+    result["load"] = options.load;
+    result["reserved_cores"] = options.reserved;
+    result["free_for_all"] = run_mode("free", options);
+    result["budget"] = run_mode("budget", options);
+    std::cout << result.dump(2) << std::endl;
+    return 0;
+}
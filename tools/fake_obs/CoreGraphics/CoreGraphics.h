@@ -0,0 +1,157 @@
+// CoreGraphics.h - Minimal CoreGraphics/CoreFoundation for building main.cpp against the OBS fake on
+// Linux: two displays side by side (1920x1080 main, 1280x720 secondary, both at 1x) and windows
+// 1-9999 at 1280x800 points on the main display. Any other window id does not exist.
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+typedef double CGFloat;
+typedef uint32_t CGDirectDisplayID;
+typedef uint32_t CGWindowID;
+typedef int32_t CGError;
+typedef long CFIndex;
+
+struct CGPoint {
+    CGFloat x;
+    CGFloat y;
+};
+
+struct CGSize {
+    CGFloat width;
+    CGFloat height;
+};
+
+struct CGRect {
+    CGPoint origin;
+    CGSize size;
+};
+
+enum {
+    kCGErrorSuccess = 0,
+    kCGErrorIllegalArgument = 1001
+};
+
+enum {
+    kCGWindowListOptionIncludingWindow = 1 << 3
+};
+
+// A window info array holds dictionaries; a dictionary here is only ever a window's bounds
+struct __CFDictionary {
+    CGRect bounds;
+    const __CFDictionary* bounds_dict;
+};
+
+struct __CFArray {
+    std::vector<__CFDictionary*> values;
+};
+
+struct __CFString {};
+
+typedef const void* CFTypeRef;
+typedef const __CFArray* CFArrayRef;
+typedef const __CFDictionary* CFDictionaryRef;
+typedef const __CFString* CFStringRef;
+
+inline const __CFString fake_cg_window_bounds_key{};
+inline const CFStringRef kCGWindowBounds = &fake_cg_window_bounds_key;
+
+namespace fake_cg {
+struct Display {
+    CGDirectDisplayID id;
+    CGRect bounds;      // points, global coordinates
+    size_t pixels_wide;
+    size_t pixels_high;
+};
+
+inline const Display displays[] = {
+    {1, {{0, 0}, {1920, 1080}}, 1920, 1080},
+    {2, {{1920, 0}, {1280, 720}}, 1280, 720},
+};
+
+inline const Display* find(CGDirectDisplayID id) {
+    for (const auto& display : displays) {
+        if (display.id == id) return &display;
+    }
+    return nullptr;
+}
+}
+
+inline CGDirectDisplayID CGMainDisplayID() {
+    return fake_cg::displays[0].id;
+}
+
+inline size_t CGDisplayPixelsWide(CGDirectDisplayID display) {
+    const fake_cg::Display* d = fake_cg::find(display);
+    return d ? d->pixels_wide : 0;
+}
+
+inline size_t CGDisplayPixelsHigh(CGDirectDisplayID display) {
+    const fake_cg::Display* d = fake_cg::find(display);
+    return d ? d->pixels_high : 0;
+}
+
+inline CGRect CGDisplayBounds(CGDirectDisplayID display) {
+    const fake_cg::Display* d = fake_cg::find(display);
+    return d ? d->bounds : CGRect{};
+}
+
+inline CGError CGGetActiveDisplayList(uint32_t max_displays, CGDirectDisplayID* active, uint32_t* count) {
+    *count = 0;
+    for (const auto& display : fake_cg::displays) {
+        if (active && *count < max_displays) active[*count] = display.id;
+        (*count)++;
+    }
+    if (active && *count > max_displays) *count = max_displays;
+    return kCGErrorSuccess;
+}
+
+inline CGError CGGetDisplaysWithRect(CGRect rect, uint32_t max_displays, CGDirectDisplayID* displays,
+                                     uint32_t* count) {
+    *count = 0;
+    for (const auto& display : fake_cg::displays) {
+        const CGRect& b = display.bounds;
+        const bool intersects = rect.origin.x < b.origin.x + b.size.width && b.origin.x < rect.origin.x + rect.size.width &&
+                                rect.origin.y < b.origin.y + b.size.height && b.origin.y < rect.origin.y + rect.size.height;
+        if (intersects && *count < max_displays) displays[(*count)++] = display.id;
+    }
+    return kCGErrorSuccess;
+}
+
+inline CFArrayRef CGWindowListCopyWindowInfo(uint32_t, CGWindowID window) {
+    auto* windows = new __CFArray();
+    if (window >= 1 && window <= 9999) {
+        auto* bounds = new __CFDictionary{{{100, 100}, {1280, 800}}, nullptr};
+        windows->values.push_back(new __CFDictionary{{}, bounds});
+    }
+    return windows;
+}
+
+inline CFIndex CFArrayGetCount(CFArrayRef array) {
+    return static_cast<CFIndex>(array->values.size());
+}
+
+inline const void* CFArrayGetValueAtIndex(CFArrayRef array, CFIndex index) {
+    return array->values[static_cast<size_t>(index)];
+}
+
+inline const void* CFDictionaryGetValue(CFDictionaryRef dict, const void* key) {
+    return key == kCGWindowBounds ? dict->bounds_dict : nullptr;
+}
+
+inline bool CGRectMakeWithDictionaryRepresentation(CFDictionaryRef dict, CGRect* rect) {
+    if (!dict) return false;
+    *rect = dict->bounds;
+    return true;
+}
+
+// Only window info arrays are ever released
+inline void CFRelease(CFTypeRef object) {
+    const auto* windows = static_cast<CFArrayRef>(object);
+    for (const __CFDictionary* info : windows->values) {
+        delete info->bounds_dict;
+        delete info;
+    }
+    delete windows;
+}
@@ -0,0 +1,1165 @@
+// obs_fake.cpp - libobs stand-in linked into tools that run main.cpp's recorder without OBS (see obs_fake.h)
+#include "obs_fake.h"
+#include "../../third_party/obs/include/obs.h"
+#include "../../third_party/obs/include/util/platform.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <algorithm>
+#include <ctime>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+using PacketCallback = void (*)(obs_output_t*, struct encoder_packet*, struct encoder_packet_time*, void*);
+using RawVideoCallback = void (*)(void*, struct video_data*);
+
+struct obs_module {};
+
+struct obs_data {
+    std::mutex mutex;
+    std::map<std::string, long long> ints;
+    std::map<std::string, std::string> strings;
+    std::map<std::string, bool> bools;
+    std::atomic<long> refs{1};
+};
+
+struct obs_source {
+    std::string id;
+    std::string name;
+    std::atomic<long> refs{1};
+    obs_scene* scene = nullptr;             // set on a scene's own source
+    const obs_source_info* info = nullptr;  // types registered through obs_register_source()
+    void* data = nullptr;
+};
+
+struct obs_scene {
+    obs_source* source = nullptr;
+    std::vector<obs_scene_item*> items;     // guarded by scene_mutex
+};
+
+struct obs_scene_item {
+    obs_scene* scene = nullptr;
+    obs_source* source = nullptr;
+};
+
+struct video_output {
+    video_output_info info = {};
+    struct Connection {
+        RawVideoCallback callback;
+        void* param;
+        uint32_t divisor;
+    };
+    std::vector<Connection> connections;    // guarded by video_mutex
+    std::vector<uint8_t> frame;             // NV12, handed to every raw callback
+    std::atomic<uint32_t> total_frames{0};
+};
+
+struct audio_output {};
+
+struct obs_view {
+    std::array<obs_source*, MAX_CHANNELS> channels = {};
+    video_output* video = nullptr;
+};
+
+struct obs_encoder {
+    bool is_video = true;
+    std::string id;
+    std::string name;
+    video_output* video = nullptr;
+    audio_output* audio = nullptr;
+    std::atomic<int> active_outputs{0};     // outputs running on this encoder
+};
+
+struct obs_service {
+    std::string id;
+    std::string name;
+    std::string server;                     // "server" setting: the egress URL
+};
+
+struct obs_output {
+    std::string id;
+    std::string name;
+    std::string path;
+    std::string last_error;
+    obs_encoder* video_encoder = nullptr;
+    obs_encoder* audio_encoder = nullptr;
+    obs_service* service = nullptr;
+
+    std::mutex callback_mutex;              // held while packets are delivered, like libobs
+    std::vector<std::pair<PacketCallback, void*>> callbacks;
+
+    std::mutex control_mutex;               // serializes start/stop
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::atomic<bool> active{false};
+    std::thread thread;
+    int fd = -1;                            // the file or socket the muxer writes to
+    bool mpegts = false;                    // ffmpeg_mpegts_muxer on a udp:// service: fd is a connected socket
+    std::vector<uint8_t> ts_datagram;       // TS packets waiting for a full datagram
+    std::array<uint8_t, 2> ts_cc = {};      // continuity counters: video, audio
+
+    std::atomic<uint64_t> total_bytes{0};
+    std::atomic<int> total_frames{0};
+};
+
+struct os_cpu_usage_info {
+    std::clock_t cpu_start;
+    Clock::time_point wall_start;
+};
+
+namespace {
+const char* const KIND_NAMES[] = {
+    "data", "sources", "scenes", "scene_items", "encoders", "outputs", "services", "views",
+    "view_videos", "video_connections", "output_channels"
+};
+static_assert(sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0]) == static_cast<size_t>(FakeObsKind::COUNT),
+              "every FakeObsKind needs a name");
+
+std::array<std::atomic<int64_t>, static_cast<size_t>(FakeObsKind::COUNT)> live_objects{};
+
+std::atomic<uint64_t> misuse{0};
+std::mutex misuse_mutex;
+std::vector<std::string> misuse_examples;
+
+void report_misuse(const std::string& what) {
+    misuse++;
+    std::lock_guard<std::mutex> lock(misuse_mutex);
+    if (misuse_examples.size() < 20) misuse_examples.push_back(what);
+}
+
+// Every object handed out, so a call on a released one is counted instead of crashing.
+// Scene sources and the main video are registered uncounted (FakeObsKind::COUNT).
+std::mutex registry_mutex;
+std::unordered_map<const void*, FakeObsKind> registry;
+
+void track(const void* object, FakeObsKind kind) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry[object] = kind;
+    if (kind != FakeObsKind::COUNT) live_objects[static_cast<size_t>(kind)]++;
+}
+
+void untrack(const void* object) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    const auto it = registry.find(object);
+    if (it == registry.end()) return;
+    if (it->second != FakeObsKind::COUNT) live_objects[static_cast<size_t>(it->second)]--;
+    registry.erase(it);
+}
+
+// nullptr is a no-op in libobs; anything else must still be alive
+bool alive(const void* object, const char* call) {
+    if (!object) return false;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        if (registry.count(object)) return true;
+    }
+    report_misuse(std::string(call) + " on a released object");
+    return false;
+}
+
+std::mutex failure_mutex;
+std::mt19937 failure_rng(1);
+std::array<int, static_cast<size_t>(FakeObsFailure::COUNT)> failure_percent = {};
+
+bool inject(FakeObsFailure call) {
+    std::lock_guard<std::mutex> lock(failure_mutex);
+    const int percent = failure_percent[static_cast<size_t>(call)];
+    return percent > 0 && static_cast<int>(failure_rng() % 100) < percent;
+}
+
+std::mutex source_type_mutex;
+std::map<std::string, obs_source_info> source_types;
+
+std::mutex scene_mutex;
+
+std::mutex channel_mutex;
+std::array<obs_source*, MAX_CHANNELS> output_channels = {};
+
+// Render loop: main video plus one video per view with a mix, in mix order
+std::mutex video_mutex;
+obs_video_info video_info = {};
+video_output* main_video = nullptr;
+std::vector<video_output*> videos;
+audio_output main_audio;
+std::atomic<uint64_t> video_frame_time{0};
+std::atomic<uint32_t> rendered_frames{0};
+std::array<std::atomic<uint64_t>, 256> frame_times{};     // by rendered frame number, for packet cts
+
+// Frames between a tick and its packet: x264's default rc_lookahead plus a couple of frame threads
+constexpr uint64_t ENCODER_DELAY = 42;
+std::atomic<uint64_t> average_frame_time_ns{0};
+
+std::mutex rendered_mutex;
+std::vector<std::pair<void (*)(void*), void*>> rendered_callbacks;
+
+std::mutex render_thread_mutex;
+std::condition_variable render_wake;
+bool render_running = false;
+std::thread render_thread;
+
+uint64_t frame_interval_ns() {
+    return video_info.fps_num ? 1000000000ULL * video_info.fps_den / video_info.fps_num : 33333333ULL;
+}
+
+video_output* create_video(const obs_video_info& ovi) {
+    auto* video = new video_output();
+    video->info.name = "fake video";
+    video->info.format = ovi.output_format;
+    video->info.fps_num = ovi.fps_num;
+    video->info.fps_den = ovi.fps_den;
+    video->info.width = ovi.output_width;
+    video->info.height = ovi.output_height;
+    video->info.colorspace = ovi.colorspace;
+    video->info.range = ovi.range;
+    video->frame.assign(static_cast<size_t>(ovi.output_width) * ovi.output_height * 3 / 2, 16);
+    return video;
+}
+
+// Caller holds video_mutex. Removing a video that still feeds raw callbacks leaves them dangling in libobs.
+void destroy_video_locked(video_output* video) {
+    if (!video->connections.empty()) {
+        report_misuse("video removed with " + std::to_string(video->connections.size()) +
+                      " raw video callback(s) still connected");
+        live_objects[static_cast<size_t>(FakeObsKind::VIDEO_CONNECTION)] -= static_cast<int64_t>(video->connections.size());
+    }
+    videos.erase(std::remove(videos.begin(), videos.end(), video), videos.end());
+    untrack(video);
+    delete video;
+}
+
+void render_loop() {
+    std::unique_lock<std::mutex> lock(render_thread_mutex);
+    auto next = Clock::now();
+    uint64_t frame = 0;
+    while (render_running) {
+        next += std::chrono::nanoseconds(frame_interval_ns());
+        if (render_wake.wait_until(lock, next, [] { return !render_running; })) break;
+        lock.unlock();
+
+        const uint64_t started = os_gettime_ns();
+        video_frame_time = started;
+        frame_times[rendered_frames.load() % frame_times.size()] = started;
+        {
+            // Like output_frames(): every mix renders in turn under the mix lock, main first, and
+            // each one runs the main-rendered callbacks; then raw callbacks, so a disconnect
+            // waits for an in-flight frame
+            std::lock_guard<std::mutex> video_lock(video_mutex);
+            for (size_t mix = 0; mix < videos.size(); ++mix) {
+                std::lock_guard<std::mutex> rendered_lock(rendered_mutex);
+                for (const auto& callback : rendered_callbacks) callback.first(callback.second);
+            }
+            for (video_output* video : videos) {
+                video->total_frames++;
+                struct video_data data = {};
+                data.data[0] = video->frame.data();
+                data.data[1] = video->frame.data() + static_cast<size_t>(video->info.width) * video->info.height;
+                data.linesize[0] = video->info.width;
+                data.linesize[1] = video->info.width;
+                data.timestamp = started;
+                for (const auto& connection : video->connections) {
+                    if (frame % std::max(connection.divisor, 1u) == 0) connection.callback(connection.param, &data);
+                }
+            }
+        }
+        rendered_frames++;
+        frame++;
+        average_frame_time_ns = (average_frame_time_ns * 7 + (os_gettime_ns() - started)) / 8;
+
+        lock.lock();
+    }
+}
+
+void release_source(obs_source* source);
+
+// Items hold a reference on their source; a scene going away drops all of them
+void destroy_source(obs_source* source) {
+    if (source->info && source->info->destroy && source->data) source->info->destroy(source->data);
+
+    if (obs_scene* scene = source->scene) {
+        std::vector<obs_scene_item*> items;
+        {
+            std::lock_guard<std::mutex> lock(scene_mutex);
+            items.swap(scene->items);
+        }
+        for (obs_scene_item* item : items) {
+            release_source(item->source);
+            untrack(item);
+            delete item;
+        }
+        untrack(scene);
+        delete scene;
+    }
+    untrack(source);
+    delete source;
+}
+
+void release_source(obs_source* source) {
+    if (source && --source->refs == 0) destroy_source(source);
+}
+
+obs_source* create_source(const char* id, const char* name, obs_data_t* settings) {
+    auto* source = new obs_source();
+    source->id = id ? id : "";
+    source->name = name ? name : "";
+    {
+        std::lock_guard<std::mutex> lock(source_type_mutex);
+        const auto it = source_types.find(source->id);
+        if (it != source_types.end()) source->info = &it->second;
+    }
+    track(source, FakeObsKind::SOURCE);
+    if (source->info && source->info->create) {
+        source->data = source->info->create(settings, source);
+        if (!source->data) {
+            destroy_source(source);
+            return nullptr;
+        }
+    }
+    return source;
+}
+
+// Annex B SPS (High, level 4.0) + PPS, and AAC-LC 48 kHz stereo; enough for the preview muxer
+const uint8_t VIDEO_HEADER[] = {0, 0, 0, 1, 0x67, 0x64, 0x00, 0x28, 0xAC, 0xD9, 0x40,
+                                0, 0, 0, 1, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0};
+const uint8_t AUDIO_CONFIG[] = {0x11, 0x90};
+
+// Like ffmpeg_mpegts_muxer over udp:// with pkt_size=1316: one PES per packet (video on PID 0x100,
+// audio on 0x101, PTS rescaled to 90 kHz from an arbitrary origin), sent seven TS packets per datagram.
+// Payloads are padded with 0xFF rather than adaptation-field stuffing. Returns the bytes sent.
+constexpr size_t TS_PACKET_SIZE = 188;
+constexpr size_t TS_PER_DATAGRAM = 7;
+constexpr uint64_t TS_PTS_ORIGIN = 126000;
+
+size_t write_mpegts(obs_output* output, const encoder_packet& packet) {
+    const bool video = packet.type == OBS_ENCODER_VIDEO;
+    const uint16_t pid = video ? 0x100 : 0x101;
+    uint8_t& cc = output->ts_cc[video ? 0 : 1];
+    const uint64_t pts = (TS_PTS_ORIGIN + static_cast<uint64_t>(packet.pts) * 90000 * packet.timebase_num /
+                                              static_cast<uint64_t>(std::max(packet.timebase_den, 1))) & ((1ULL << 33) - 1);
+    const uint8_t pes[14] = {
+        0x00, 0x00, 0x01, static_cast<uint8_t>(video ? 0xE0 : 0xC0), 0x00, 0x00, 0x80, 0x80, 0x05,
+        static_cast<uint8_t>(0x21 | ((pts >> 29) & 0x0E)),
+        static_cast<uint8_t>(pts >> 22),
+        static_cast<uint8_t>(0x01 | ((pts >> 14) & 0xFE)),
+        static_cast<uint8_t>(pts >> 7),
+        static_cast<uint8_t>(0x01 | ((pts << 1) & 0xFE))
+    };
+
+    size_t sent = 0;
+    size_t offset = 0;
+    for (bool first = true; first || offset < packet.size; first = false) {
+        uint8_t ts[TS_PACKET_SIZE];
+        std::memset(ts, 0xFF, sizeof(ts));
+        ts[0] = 0x47;
+        ts[1] = static_cast<uint8_t>((first ? 0x40 : 0x00) | (pid >> 8));
+        ts[2] = pid & 0xFF;
+        ts[3] = static_cast<uint8_t>(0x10 | cc);
+        cc = (cc + 1) & 0x0F;
+
+        size_t position = 4;
+        if (first) {
+            std::memcpy(ts + position, pes, sizeof(pes));
+            position += sizeof(pes);
+        }
+        const size_t chunk = std::min(packet.size - offset, TS_PACKET_SIZE - position);
+        std::memcpy(ts + position, packet.data + offset, chunk);
+        offset += chunk;
+
+        output->ts_datagram.insert(output->ts_datagram.end(), ts, ts + TS_PACKET_SIZE);
+        if (output->ts_datagram.size() == TS_PACKET_SIZE * TS_PER_DATAGRAM) {
+            // A receiver that is not listening yet refuses the datagram; the muxer keeps going
+            if (send(output->fd, output->ts_datagram.data(), output->ts_datagram.size(), 0) > 0) {
+                sent += output->ts_datagram.size();
+            }
+            output->ts_datagram.clear();
+        }
+    }
+    return sent;
+}
+
+size_t write_packet(obs_output* output, const encoder_packet& packet) {
+    if (output->mpegts) return write_mpegts(output, packet);
+    return write(output->fd, packet.data, packet.size) > 0 ? packet.size : 0;
+}
+
+// udp://host:port[?options] of the output's service as a connected socket, or -1 for anything
+// else (srt:// and rist:// are not emulated)
+int open_udp(const obs_output* output) {
+    if (!output->service || output->service->server.rfind("udp://", 0) != 0) return -1;
+    const std::string address = output->service->server.substr(6, output->service->server.find('?') - 6);
+    const size_t colon = address.rfind(':');
+    if (colon == std::string::npos) return -1;
+    std::string host = address.substr(0, colon);
+    if (host == "localhost") host = "127.0.0.1";
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(std::atoi(address.c_str() + colon + 1)));
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) return -1;
+
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// The muxer thread: every frame rendered since the output started comes out as one video packet,
+// ENCODER_DELAY frames late like x264 with lookahead, plus the matching AAC frames, delivered to the
+// packet callbacks in interleaved order and written to the output's fd
+void output_loop(obs_output* output) {
+    const uint32_t fps = video_info.fps_den ? std::max(1u, video_info.fps_num / video_info.fps_den) : 30;
+    const auto interval = std::chrono::nanoseconds(frame_interval_ns());
+    std::vector<uint8_t> video_data(4 + 1 + 4096, 0);
+    std::vector<uint8_t> audio_data(256, 0);
+    video_data[3] = 1;
+    int64_t audio_dts = 0;
+    // The frame being rendered now may have run its callbacks before this output's mix existed
+    const uint64_t first_frame = rendered_frames.load() + 1;
+
+    auto next = Clock::now();
+    for (int64_t frame = 0;;) {
+        next += interval;
+        {
+            std::unique_lock<std::mutex> lock(output->wake_mutex);
+            if (output->wake.wait_until(lock, next, [output] { return output->stopping; })) return;
+        }
+
+        // At most two per tick, so a late tick catches up without bursting
+        for (int burst = 0; burst < 2 && first_frame + frame + ENCODER_DELAY < rendered_frames.load();
+             ++burst, ++frame) {
+            const bool keyframe = frame % (2 * fps) == 0;
+            video_data[4] = keyframe ? 0x65 : 0x41;
+            struct encoder_packet video = {};
+            video.data = video_data.data();
+            video.size = keyframe ? video_data.size() : video_data.size() / 4;
+            video.pts = frame;
+            video.dts = frame;
+            video.timebase_num = 1;
+            video.timebase_den = static_cast<int32_t>(fps);
+            video.type = OBS_ENCODER_VIDEO;
+            video.keyframe = keyframe;
+            struct encoder_packet_time timing = {};
+            timing.pts = frame;
+            timing.cts = frame_times[(first_frame + frame) % frame_times.size()].load();
+            timing.fer = std::max<uint64_t>(timing.cts, os_gettime_ns());
+            timing.ferc = os_gettime_ns();
+            timing.pir = os_gettime_ns();
+
+            std::lock_guard<std::mutex> lock(output->callback_mutex);
+            for (const auto& callback : output->callbacks) callback.first(output, &video, &timing, callback.second);
+            output->total_bytes += write_packet(output, video);
+            output->total_frames++;
+
+            if (output->audio_encoder) {
+                for (; audio_dts * static_cast<int64_t>(fps) < (frame + 1) * 48000; audio_dts += 1024) {
+                    struct encoder_packet audio = {};
+                    audio.data = audio_data.data();
+                    audio.size = audio_data.size();
+                    audio.pts = audio_dts;
+                    audio.dts = audio_dts;
+                    audio.timebase_num = 1;
+                    audio.timebase_den = 48000;
+                    audio.type = OBS_ENCODER_AUDIO;
+                    audio.track_idx = 0;
+                    for (const auto& callback : output->callbacks) callback.first(output, &audio, nullptr, callback.second);
+                    output->total_bytes += write_packet(output, audio);
+                }
+            }
+        }
+    }
+}
+
+// Caller holds control_mutex
+void stop_output_locked(obs_output* output) {
+    if (!output->active) return;
+    {
+        std::lock_guard<std::mutex> lock(output->wake_mutex);
+        output->stopping = true;
+    }
+    output->wake.notify_all();
+    if (output->thread.joinable()) output->thread.join();
+    if (output->fd >= 0) {
+        close(output->fd);
+        output->fd = -1;
+    }
+    if (output->video_encoder) output->video_encoder->active_outputs--;
+    if (output->audio_encoder) output->audio_encoder->active_outputs--;
+    output->stopping = false;
+    output->active = false;
+}
+}
+
+// ---- FakeObs -------------------------------------------------------------------------------------
+
+void FakeObs::set_failure_percent(FakeObsFailure call, int percent) {
+    std::lock_guard<std::mutex> lock(failure_mutex);
+    failure_percent[static_cast<size_t>(call)] = std::clamp(percent, 0, 100);
+}
+
+void FakeObs::set_seed(uint32_t seed) {
+    std::lock_guard<std::mutex> lock(failure_mutex);
+    failure_rng.seed(seed);
+}
+
+int64_t FakeObs::live(FakeObsKind kind) {
+    return live_objects[static_cast<size_t>(kind)].load();
+}
+
+int64_t FakeObs::live_total() {
+    int64_t total = 0;
+    for (const auto& count : live_objects) total += count.load();
+    return total;
+}
+
+json FakeObs::get_ledger() {
+    json ledger;
+    for (size_t i = 0; i < live_objects.size(); ++i) ledger[KIND_NAMES[i]] = live_objects[i].load();
+    return ledger;
+}
+
+uint64_t FakeObs::misuse_count() {
+    return misuse.load();
+}
+
+json FakeObs::get_misuse() {
+    std::lock_guard<std::mutex> lock(misuse_mutex);
+    return misuse_examples;
+}
+
+// ---- Core ----------------------------------------------------------------------------------------
+
+bool obs_startup(const char*, const char*, profiler_name_store_t*) {
+    return true;
+}
+
+void obs_shutdown(void) {
+    {
+        std::lock_guard<std::mutex> lock(render_thread_mutex);
+        render_running = false;
+    }
+    render_wake.notify_all();
+    if (render_thread.joinable()) render_thread.join();
+
+    std::lock_guard<std::mutex> lock(video_mutex);
+    if (main_video) {
+        destroy_video_locked(main_video);
+        main_video = nullptr;
+    }
+}
+
+int obs_open_module(obs_module_t** module, const char*, const char*) {
+    static obs_module fake_module;
+    *module = &fake_module;
+    return MODULE_SUCCESS;
+}
+
+bool obs_init_module(obs_module_t*) {
+    return true;
+}
+
+void obs_register_source_s(const struct obs_source_info* info, size_t size) {
+    obs_source_info copy = {};
+    std::memcpy(&copy, info, std::min(size, sizeof(copy)));
+    std::lock_guard<std::mutex> lock(source_type_mutex);
+    source_types[copy.id] = copy;
+}
+
+int obs_reset_video(struct obs_video_info* ovi) {
+    {
+        std::lock_guard<std::mutex> lock(video_mutex);
+        video_info = *ovi;
+        if (!main_video) {
+            main_video = create_video(*ovi);
+            track(main_video, FakeObsKind::COUNT);
+            videos.push_back(main_video);
+        }
+    }
+    std::lock_guard<std::mutex> lock(render_thread_mutex);
+    if (!render_running) {
+        render_running = true;
+        render_thread = std::thread(render_loop);
+    }
+    return OBS_VIDEO_SUCCESS;
+}
+
+bool obs_reset_audio(const struct obs_audio_info*) {
+    return true;
+}
+
+bool obs_get_video_info(struct obs_video_info* ovi) {
+    std::lock_guard<std::mutex> lock(video_mutex);
+    if (!main_video) return false;
+    *ovi = video_info;
+    return true;
+}
+
+video_t* obs_get_video(void) {
+    std::lock_guard<std::mutex> lock(video_mutex);
+    return main_video;
+}
+
+audio_t* obs_get_audio(void) {
+    return &main_audio;
+}
+
+uint64_t obs_get_video_frame_time(void) {
+    return video_frame_time.load();
+}
+
+uint64_t obs_get_frame_interval_ns(void) {
+    return frame_interval_ns();
+}
+
+uint64_t obs_get_average_frame_time_ns(void) {
+    return average_frame_time_ns.load();
+}
+
+uint32_t obs_get_total_frames(void) {
+    return rendered_frames.load();
+}
+
+uint32_t obs_get_lagged_frames(void) {
+    return 0;
+}
+
+void obs_add_main_rendered_callback(void (*rendered)(void* param), void* param) {
+    std::lock_guard<std::mutex> lock(rendered_mutex);
+    rendered_callbacks.emplace_back(rendered, param);
+}
+
+void obs_remove_main_rendered_callback(void (*rendered)(void* param), void* param) {
+    std::lock_guard<std::mutex> lock(rendered_mutex);
+    rendered_callbacks.erase(std::remove(rendered_callbacks.begin(), rendered_callbacks.end(),
+                                         std::make_pair(rendered, param)),
+                             rendered_callbacks.end());
+}
+
+void obs_set_output_source(uint32_t channel, obs_source_t* source) {
+    if (channel >= MAX_CHANNELS) return;
+    if (source && !alive(source, "obs_set_output_source")) return;
+
+    obs_source* previous;
+    {
+        std::lock_guard<std::mutex> lock(channel_mutex);
+        if (source) source->refs++;
+        previous = output_channels[channel];
+        output_channels[channel] = source;
+    }
+    if (source) live_objects[static_cast<size_t>(FakeObsKind::OUTPUT_CHANNEL)]++;
+    if (previous) {
+        live_objects[static_cast<size_t>(FakeObsKind::OUTPUT_CHANNEL)]--;
+        release_source(previous);
+    }
+}
+
+// ---- Settings ------------------------------------------------------------------------------------
+
+obs_data_t* obs_data_create() {
+    auto* data = new obs_data();
+    track(data, FakeObsKind::DATA);
+    return data;
+}
+
+void obs_data_release(obs_data_t* data) {
+    if (!alive(data, "obs_data_release")) return;
+    if (--data->refs == 0) {
+        untrack(data);
+        delete data;
+    }
+}
+
+void obs_data_set_bool(obs_data_t* data, const char* name, bool val) {
+    if (!alive(data, "obs_data_set_bool")) return;
+    std::lock_guard<std::mutex> lock(data->mutex);
+    data->bools[name] = val;
+}
+
+void obs_data_set_int(obs_data_t* data, const char* name, long long val) {
+    if (!alive(data, "obs_data_set_int")) return;
+    std::lock_guard<std::mutex> lock(data->mutex);
+    data->ints[name] = val;
+}
+
+void obs_data_set_string(obs_data_t* data, const char* name, const char* val) {
+    if (!alive(data, "obs_data_set_string")) return;
+    std::lock_guard<std::mutex> lock(data->mutex);
+    data->strings[name] = val ? val : "";
+}
+
+long long obs_data_get_int(obs_data_t* data, const char* name) {
+    if (!alive(data, "obs_data_get_int")) return 0;
+    std::lock_guard<std::mutex> lock(data->mutex);
+    const auto it = data->ints.find(name);
+    return it != data->ints.end() ? it->second : 0;
+}
+
+// ---- Sources and scenes --------------------------------------------------------------------------
+
+obs_source_t* obs_source_create(const char* id, const char* name, obs_data_t* settings, obs_data_t*) {
+    if (inject(FakeObsFailure::SOURCE_CREATE)) return nullptr;
+    return create_source(id, name, settings);
+}
+
+obs_source_t* obs_source_create_private(const char* id, const char* name, obs_data_t* settings) {
+    return create_source(id, name, settings);
+}
+
+void obs_source_release(obs_source_t* source) {
+    if (!alive(source, "obs_source_release")) return;
+    release_source(source);
+}
+
+void obs_source_output_video2(obs_source_t* source, const struct obs_source_frame2*) {
+    alive(source, "obs_source_output_video2");
+}
+
+obs_scene_t* obs_scene_create(const char* name) {
+    auto* scene = new obs_scene();
+    scene->source = new obs_source();
+    scene->source->id = "scene";
+    scene->source->name = name ? name : "";
+    scene->source->scene = scene;
+    track(scene, FakeObsKind::SCENE);
+    track(scene->source, FakeObsKind::COUNT);
+    return scene;
+}
+
+obs_source_t* obs_scene_get_source(const obs_scene_t* scene) {
+    if (!alive(scene, "obs_scene_get_source")) return nullptr;
+    return scene->source;
+}
+
+void obs_scene_release(obs_scene_t* scene) {
+    if (!alive(scene, "obs_scene_release")) return;
+    release_source(scene->source);
+}
+
+obs_sceneitem_t* obs_scene_add(obs_scene_t* scene, obs_source_t* source) {
+    if (!alive(scene, "obs_scene_add") || !alive(source, "obs_scene_add")) return nullptr;
+    auto* item = new obs_scene_item();
+    item->scene = scene;
+    item->source = source;
+    source->refs++;
+    {
+        std::lock_guard<std::mutex> lock(scene_mutex);
+        scene->items.push_back(item);
+    }
+    track(item, FakeObsKind::SCENE_ITEM);
+    return item;
+}
+
+void obs_sceneitem_remove(obs_sceneitem_t* item) {
+    if (!alive(item, "obs_sceneitem_remove")) return;
+    {
+        std::lock_guard<std::mutex> lock(scene_mutex);
+        auto& items = item->scene->items;
+        items.erase(std::remove(items.begin(), items.end(), item), items.end());
+    }
+    release_source(item->source);
+    untrack(item);
+    delete item;
+}
+
+void obs_sceneitem_set_bounds(obs_sceneitem_t* item, const struct vec2*) {
+    alive(item, "obs_sceneitem_set_bounds");
+}
+
+void obs_sceneitem_set_bounds_type(obs_sceneitem_t* item, enum obs_bounds_type) {
+    alive(item, "obs_sceneitem_set_bounds_type");
+}
+
+void obs_sceneitem_set_crop(obs_sceneitem_t* item, const struct obs_sceneitem_crop*) {
+    alive(item, "obs_sceneitem_set_crop");
+}
+
+void obs_sceneitem_set_scale(obs_sceneitem_t* item, const struct vec2*) {
+    alive(item, "obs_sceneitem_set_scale");
+}
+
+// ---- Views ---------------------------------------------------------------------------------------
+
+obs_view_t* obs_view_create(void) {
+    auto* view = new obs_view();
+    track(view, FakeObsKind::VIEW);
+    return view;
+}
+
+void obs_view_set_source(obs_view_t* view, uint32_t channel, obs_source_t* source) {
+    if (!alive(view, "obs_view_set_source") || channel >= MAX_CHANNELS) return;
+    if (source && !alive(source, "obs_view_set_source")) return;
+    obs_source* previous;
+    {
+        std::lock_guard<std::mutex> lock(channel_mutex);
+        if (source) source->refs++;
+        previous = view->channels[channel];
+        view->channels[channel] = source;
+    }
+    release_source(previous);
+}
+
+video_t* obs_view_add2(obs_view_t* view, struct obs_video_info* ovi) {
+    if (!alive(view, "obs_view_add2") || !ovi) return nullptr;
+    if (inject(FakeObsFailure::VIEW_ADD)) return nullptr;
+    std::lock_guard<std::mutex> lock(video_mutex);
+    if (view->video) return view->video;
+    view->video = create_video(*ovi);
+    track(view->video, FakeObsKind::VIEW_VIDEO);
+    videos.push_back(view->video);
+    return view->video;
+}
+
+void obs_view_remove(obs_view_t* view) {
+    if (!alive(view, "obs_view_remove")) return;
+    std::lock_guard<std::mutex> lock(video_mutex);
+    if (view->video) {
+        destroy_video_locked(view->video);
+        view->video = nullptr;
+    }
+}
+
+void obs_view_destroy(obs_view_t* view) {
+    if (!alive(view, "obs_view_destroy")) return;
+    obs_view_remove(view);
+    for (uint32_t channel = 0; channel < MAX_CHANNELS; ++channel) {
+        if (view->channels[channel]) obs_view_set_source(view, channel, nullptr);
+    }
+    untrack(view);
+    delete view;
+}
+
+// ---- Raw video -----------------------------------------------------------------------------------
+
+const struct video_output_info* video_output_get_info(const video_t* video) {
+    if (!alive(video, "video_output_get_info")) return nullptr;
+    return &video->info;
+}
+
+bool video_output_connect2(video_t* video, const struct video_scale_info*, uint32_t frame_rate_divisor,
+                           void (*callback)(void* param, struct video_data* frame), void* param) {
+    if (!alive(video, "video_output_connect2")) return false;
+    std::lock_guard<std::mutex> lock(video_mutex);
+    video->connections.push_back({callback, param, frame_rate_divisor});
+    live_objects[static_cast<size_t>(FakeObsKind::VIDEO_CONNECTION)]++;
+    return true;
+}
+
+void video_output_disconnect(video_t* video, void (*callback)(void* param, struct video_data* frame), void* param) {
+    if (!alive(video, "video_output_disconnect")) return;
+    std::lock_guard<std::mutex> lock(video_mutex);
+    auto& connections = video->connections;
+    const auto it = std::find_if(connections.begin(), connections.end(), [&](const video_output::Connection& c) {
+        return c.callback == callback && c.param == param;
+    });
+    if (it != connections.end()) {
+        connections.erase(it);
+        live_objects[static_cast<size_t>(FakeObsKind::VIDEO_CONNECTION)]--;
+    }
+}
+
+uint32_t video_output_get_total_frames(const video_t* video) {
+    return alive(video, "video_output_get_total_frames") ? video->total_frames.load() : 0;
+}
+
+uint32_t video_output_get_skipped_frames(const video_t* video) {
+    alive(video, "video_output_get_skipped_frames");
+    return 0;
+}
+
+bool video_format_get_parameters_for_format(enum video_colorspace, enum video_range_type, enum video_format,
+                                            float matrix[16], float min_range[3], float max_range[3]) {
+    for (int i = 0; i < 16; ++i) matrix[i] = i % 5 == 0 ? 1.0f : 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        min_range[i] = 0.0f;
+        max_range[i] = 1.0f;
+    }
+    return true;
+}
+
+// ---- Encoders ------------------------------------------------------------------------------------
+
+obs_encoder_t* obs_video_encoder_create(const char* id, const char* name, obs_data_t* settings, obs_data_t*) {
+    if (settings && !alive(settings, "obs_video_encoder_create")) return nullptr;
+    if (inject(FakeObsFailure::ENCODER_CREATE)) return nullptr;
+    auto* encoder = new obs_encoder();
+    encoder->is_video = true;
+    encoder->id = id ? id : "";
+    encoder->name = name ? name : "";
+    track(encoder, FakeObsKind::ENCODER);
+    return encoder;
+}
+
+obs_encoder_t* obs_audio_encoder_create(const char* id, const char* name, obs_data_t* settings, size_t,
+                                        obs_data_t*) {
+    if (settings && !alive(settings, "obs_audio_encoder_create")) return nullptr;
+    if (inject(FakeObsFailure::ENCODER_CREATE)) return nullptr;
+    auto* encoder = new obs_encoder();
+    encoder->is_video = false;
+    encoder->id = id ? id : "";
+    encoder->name = name ? name : "";
+    track(encoder, FakeObsKind::ENCODER);
+    return encoder;
+}
+
+void obs_encoder_release(obs_encoder_t* encoder) {
+    if (!alive(encoder, "obs_encoder_release")) return;
+    if (encoder->active_outputs > 0) {
+        report_misuse("encoder '" + encoder->name + "' released while an active output still uses it");
+    }
+    untrack(encoder);
+    delete encoder;
+}
+
+void obs_encoder_set_video(obs_encoder_t* encoder, video_t* video) {
+    if (!alive(encoder, "obs_encoder_set_video") || !alive(video, "obs_encoder_set_video")) return;
+    encoder->video = video;
+}
+
+void obs_encoder_set_audio(obs_encoder_t* encoder, audio_t* audio) {
+    if (!alive(encoder, "obs_encoder_set_audio")) return;
+    encoder->audio = audio;
+}
+
+uint32_t obs_encoder_get_width(const obs_encoder_t* encoder) {
+    if (!alive(encoder, "obs_encoder_get_width") || !encoder->video) return 0;
+    return encoder->video->info.width;
+}
+
+uint32_t obs_encoder_get_height(const obs_encoder_t* encoder) {
+    if (!alive(encoder, "obs_encoder_get_height") || !encoder->video) return 0;
+    return encoder->video->info.height;
+}
+
+uint32_t obs_encoder_get_sample_rate(const obs_encoder_t* encoder) {
+    return alive(encoder, "obs_encoder_get_sample_rate") && !encoder->is_video ? 48000 : 0;
+}
+
+size_t obs_encoder_get_frame_size(const obs_encoder_t* encoder) {
+    return alive(encoder, "obs_encoder_get_frame_size") && !encoder->is_video ? 1024 : 0;
+}
+
+// Headers exist once the encoder has been opened by a started output
+bool obs_encoder_get_extra_data(const obs_encoder_t* encoder, uint8_t** extra_data, size_t* size) {
+    if (!alive(encoder, "obs_encoder_get_extra_data") || encoder->active_outputs == 0) return false;
+    *extra_data = const_cast<uint8_t*>(encoder->is_video ? VIDEO_HEADER : AUDIO_CONFIG);
+    *size = encoder->is_video ? sizeof(VIDEO_HEADER) : sizeof(AUDIO_CONFIG);
+    return true;
+}
+
+// ---- Services ------------------------------------------------------------------------------------
+
+obs_service_t* obs_service_create(const char* id, const char* name, obs_data_t* settings, obs_data_t*) {
+    if (settings && !alive(settings, "obs_service_create")) return nullptr;
+    auto* service = new obs_service();
+    service->id = id ? id : "";
+    service->name = name ? name : "";
+    if (settings) {
+        std::lock_guard<std::mutex> lock(settings->mutex);
+        const auto it = settings->strings.find("server");
+        if (it != settings->strings.end()) service->server = it->second;
+    }
+    track(service, FakeObsKind::SERVICE);
+    return service;
+}
+
+void obs_service_release(obs_service_t* service) {
+    if (!alive(service, "obs_service_release")) return;
+    untrack(service);
+    delete service;
+}
+
+// ---- Outputs -------------------------------------------------------------------------------------
+
+obs_output_t* obs_output_create(const char* id, const char* name, obs_data_t* settings, obs_data_t*) {
+    if (settings && !alive(settings, "obs_output_create")) return nullptr;
+    auto* output = new obs_output();
+    output->id = id ? id : "";
+    output->name = name ? name : "";
+    if (settings) {
+        std::lock_guard<std::mutex> lock(settings->mutex);
+        const auto it = settings->strings.find("path");
+        if (it != settings->strings.end()) output->path = it->second;
+    }
+    track(output, FakeObsKind::OUTPUT);
+    return output;
+}
+
+void obs_output_release(obs_output_t* output) {
+    if (!alive(output, "obs_output_release")) return;
+    {
+        std::lock_guard<std::mutex> lock(output->control_mutex);
+        if (output->active) {
+            report_misuse("output '" + output->name + "' released while active");
+            stop_output_locked(output);
+        }
+    }
+    untrack(output);
+    delete output;
+}
+
+void obs_output_set_video_encoder(obs_output_t* output, obs_encoder_t* encoder) {
+    if (!alive(output, "obs_output_set_video_encoder")) return;
+    if (encoder && !alive(encoder, "obs_output_set_video_encoder")) return;
+    output->video_encoder = encoder;
+}
+
+void obs_output_set_audio_encoder(obs_output_t* output, obs_encoder_t* encoder, size_t) {
+    if (!alive(output, "obs_output_set_audio_encoder")) return;
+    if (encoder && !alive(encoder, "obs_output_set_audio_encoder")) return;
+    output->audio_encoder = encoder;
+}
+
+void obs_output_set_service(obs_output_t* output, obs_service_t* service) {
+    if (!alive(output, "obs_output_set_service")) return;
+    if (service && !alive(service, "obs_output_set_service")) return;
+    output->service = service;
+}
+
+void obs_output_set_reconnect_settings(obs_output_t* output, int, int) {
+    alive(output, "obs_output_set_reconnect_settings");
+}
+
+void obs_output_add_packet_callback(obs_output_t* output,
+                                    void (*packet_cb)(obs_output_t* output, struct encoder_packet* pkt,
+                                                      struct encoder_packet_time* pkt_time, void* param),
+                                    void* param) {
+    if (!alive(output, "obs_output_add_packet_callback")) return;
+    std::lock_guard<std::mutex> lock(output->callback_mutex);
+    output->callbacks.emplace_back(packet_cb, param);
+}
+
+void obs_output_remove_packet_callback(obs_output_t* output,
+                                       void (*packet_cb)(obs_output_t* output, struct encoder_packet* pkt,
+                                                         struct encoder_packet_time* pkt_time, void* param),
+                                       void* param) {
+    if (!alive(output, "obs_output_remove_packet_callback")) return;
+    std::lock_guard<std::mutex> lock(output->callback_mutex);
+    auto& callbacks = output->callbacks;
+    callbacks.erase(std::remove(callbacks.begin(), callbacks.end(), std::make_pair(packet_cb, param)), callbacks.end());
+}
+
+bool obs_output_start(obs_output_t* output) {
+    if (!alive(output, "obs_output_start")) return false;
+    std::lock_guard<std::mutex> lock(output->control_mutex);
+    if (output->active) return true;
+
+    if (!output->video_encoder || !alive(output->video_encoder, "obs_output_start") || !output->video_encoder->video) {
+        output->last_error = "No video encoder, or it has no video";
+        return false;
+    }
+    if (inject(FakeObsFailure::OUTPUT_START)) {
+        output->last_error = "Injected start failure";
+        return false;
+    }
+
+    output->fd = output->id == "ffmpeg_mpegts_muxer" ? open_udp(output) : -1;
+    output->mpegts = output->fd >= 0;
+    output->ts_datagram.clear();
+    if (output->fd < 0) output->fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (output->fd < 0) {
+        output->last_error = "Failed to open output file";
+        return false;
+    }
+    output->last_error.clear();
+    output->video_encoder->active_outputs++;
+    if (output->audio_encoder) output->audio_encoder->active_outputs++;
+    output->active = true;
+    output->thread = std::thread(output_loop, output);
+    return true;
+}
+
+void obs_output_stop(obs_output_t* output) {
+    if (!alive(output, "obs_output_stop")) return;
+    std::lock_guard<std::mutex> lock(output->control_mutex);
+    stop_output_locked(output);
+}
+
+void obs_output_force_stop(obs_output_t* output) {
+    obs_output_stop(output);
+}
+
+bool obs_output_active(const obs_output_t* output) {
+    return alive(output, "obs_output_active") && output->active;
+}
+
+bool obs_output_reconnecting(const obs_output_t* output) {
+    alive(output, "obs_output_reconnecting");
+    return false;
+}
+
+const char* obs_output_get_last_error(obs_output_t* output) {
+    if (!alive(output, "obs_output_get_last_error") || output->last_error.empty()) return nullptr;
+    return output->last_error.c_str();
+}
+
+uint64_t obs_output_get_total_bytes(const obs_output_t* output) {
+    return alive(output, "obs_output_get_total_bytes") ? output->total_bytes.load() : 0;
+}
+
+int obs_output_get_total_frames(const obs_output_t* output) {
+    return alive(output, "obs_output_get_total_frames") ? output->total_frames.load() : 0;
+}
+
+int obs_output_get_frames_dropped(const obs_output_t* output) {
+    alive(output, "obs_output_get_frames_dropped");
+    return 0;
+}
+
+float obs_output_get_congestion(obs_output_t* output) {
+    alive(output, "obs_output_get_congestion");
+    return 0.0f;
+}
+
+int obs_output_get_connect_time_ms(obs_output_t* output) {
+    alive(output, "obs_output_get_connect_time_ms");
+    return 0;
+}
+
+// ---- Platform ------------------------------------------------------------------------------------
+
+uint64_t os_gettime_ns(void) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+}
+
+void os_sleep_ms(uint32_t duration) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(duration));
+}
+
+int os_get_logical_cores(void) {
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+os_cpu_usage_info_t* os_cpu_usage_info_start(void) {
+    return new os_cpu_usage_info{std::clock(), Clock::now()};
+}
+
+// Process CPU as a share of all cores, like libobs
+double os_cpu_usage_info_query(os_cpu_usage_info_t* info) {
+    if (!info) return 0.0;
+    const double cpu = static_cast<double>(std::clock() - info->cpu_start) / CLOCKS_PER_SEC;
+    const double wall = std::chrono::duration<double>(Clock::now() - info->wall_start).count();
+    return wall > 0 ? cpu / wall / os_get_logical_cores() * 100.0 : 0.0;
+}
+
+void os_cpu_usage_info_destroy(os_cpu_usage_info_t* info) {
+    delete info;
+}
@@ -0,0 +1,49 @@
+// obs_fake.h - Link-time stand-in for the libobs calls main.cpp makes (obs_fake.cpp), so the real
+// StreamRecorder/RecordingManager run without OBS, capture hardware or a GPU. Objects are
+// refcounted like libobs (scene items and output channels hold their source). Outputs run a muxer
+// thread that feeds packet callbacks with an encoder's lookahead delay (an ffmpeg_mpegts_muxer on a
+// udp:// service also sends real MPEG-TS datagrams there, for egress_probe), and a render thread runs
+// the main-rendered callbacks once per mix (main, then each view) and every raw video connection.
+// Each object kind has a live count, and misuse that real libobs would crash or leak on (a call on
+// a released object, an output released while active, ...) is counted.
+#pragma once
+
+#include "../../third_party/json.hpp"
+#include <cstdint>
+
+enum class FakeObsKind {
+    DATA,
+    SOURCE,
+    SCENE,
+    SCENE_ITEM,
+    ENCODER,
+    OUTPUT,
+    SERVICE,
+    VIEW,
+    VIEW_VIDEO,
+    VIDEO_CONNECTION,   // raw video callbacks (frame tap)
+    OUTPUT_CHANNEL,     // global output channels holding a source
+    COUNT
+};
+
+// Calls that can be made to fail, like a capture source or encoder that won't open
+enum class FakeObsFailure {
+    SOURCE_CREATE,      // obs_source_create (screen, desktop audio and mic capture)
+    ENCODER_CREATE,     // obs_video_encoder_create / obs_audio_encoder_create
+    OUTPUT_START,       // obs_output_start (recording and egress)
+    VIEW_ADD,           // obs_view_add2 (window/region canvases)
+    COUNT
+};
+
+class FakeObs {
+public:
+    static void set_failure_percent(FakeObsFailure call, int percent);
+    static void set_seed(uint32_t seed);
+
+    static int64_t live(FakeObsKind kind);
+    static int64_t live_total();
+    static nlohmann::json get_ledger();     // kind -> live count
+
+    static uint64_t misuse_count();
+    static nlohmann::json get_misuse();     // the first few misuse descriptions
+};
@@ -0,0 +1,207 @@
+// frame_tap_bench.cpp - Throughput/latency benchmark for the shared-memory frame tap.
+// The parent publishes synthetic NV12 frames through FrameTapWriter; forked consumer processes
+// read them through FrameTapReader, so the numbers include real cross-process cache traffic.
+// Slow consumers sleep per frame to show they skip instead of slowing the producer.
+#include "../third_party/json.hpp"
+#include "../frame_tap_ring.h"
+#include "../latency_histogram.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    uint32_t slots = 4;
+    int fps = 30;                   // 0 = publish as fast as possible
+    int duration_s = 10;
+    int consumers = 2;
+    int slow_consumers = 1;
+    int slow_consumer_ms = 100;
+};
+
+static bool parse_args(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        const int value = std::atoi(argv[i + 1]);
+        if (arg == "--width") options.width = static_cast<uint32_t>(value);
+        else if (arg == "--height") options.height = static_cast<uint32_t>(value);
+        else if (arg == "--slots") options.slots = static_cast<uint32_t>(value);
+        else if (arg == "--fps") options.fps = value;
+        else if (arg == "--duration") options.duration_s = value;
+        else if (arg == "--consumers") options.consumers = value;
+        else if (arg == "--slow-consumers") options.slow_consumers = value;
+        else if (arg == "--slow-consumer-ms") options.slow_consumer_ms = value;
+        else return false;
+    }
+    return argc % 2 == 1 && options.width > 0 && options.height > 0 && options.duration_s > 0;
+}
+
+static json histogram_ms(const LatencyHistogram& h) {
+    return {
+        {"p50", h.percentile(0.50) / 1000.0},
+        {"p99", h.percentile(0.99) / 1000.0},
+        {"p999", h.percentile(0.999) / 1000.0},
+        {"max", h.max() / 1000.0}
+    };
+}
+
+// Runs in a child process; the frame number stamped into the first and last bytes of every
+// frame detects torn reads that still_valid() failed to catch
+static json run_consumer(const std::string& shm_name, int delay_ms) {
+    FrameTapReader reader;
+    json result;
+    for (int attempt = 0; attempt < 200 && !reader.open(shm_name); ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (reader.frame_bytes() == 0) {
+        result["error"] = "open failed";
+        return result;
+    }
+
+    LatencyHistogram latency_us;
+    uint64_t frames = 0;
+    uint64_t discarded = 0;
+    uint64_t corrupt = 0;
+    FrameTapReader::Frame frame;
+
+    while (reader.next(frame, std::chrono::milliseconds(2000), std::chrono::microseconds(100))) {
+        latency_us.record((frame_tap_now_ns() - frame.publish_ns) / 1000);
+
+        // Stand-in for analytics work that touches every pixel
+        uint64_t head, tail, sum = 0;
+        std::memcpy(&head, frame.y, sizeof(head));
+        for (size_t i = 0; i < reader.frame_bytes(); i += 4096) sum += frame.y[i];
+        std::memcpy(&tail, frame.y + reader.frame_bytes() - sizeof(tail), sizeof(tail));
+        asm volatile("" : : "r"(sum));
+
+        if (delay_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+
+        if (!reader.still_valid(frame)) {
+            discarded++;
+            continue;
+        }
+        if (head != frame.frame_number || tail != frame.frame_number) corrupt++;
+        frames++;
+    }
+
+    result["frames"] = frames;
+    result["skipped"] = reader.frames_skipped();
+    result["torn_retries"] = reader.torn_reads();
+    result["discarded_after_read"] = discarded;
+    result["corrupt"] = corrupt;
+    result["publish_to_read_ms"] = histogram_ms(latency_us);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parse_args(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--width N] [--height N] [--slots N] [--fps N (0 = unthrottled)]\n"
+                  << "       [--duration S] [--consumers N] [--slow-consumers N] [--slow-consumer-ms MS]" << std::endl;
+        return 2;
+    }
+
+    const std::string shm_name = frame_tap_shm_name("bench-" + std::to_string(getpid()));
+    FrameTapWriter writer;
+    if (!writer.create(shm_name, options.width, options.height, options.slots)) {
+        std::cerr << "Failed to create " << shm_name << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    struct Child {
+        pid_t pid;
+        int fd;
+        bool slow;
+    };
+    std::vector<Child> children;
+    for (int i = 0; i < options.consumers + options.slow_consumers; ++i) {
+        const bool slow = i >= options.consumers;
+        int fds[2];
+        if (pipe(fds) != 0) return 1;
+        const pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            const std::string out = run_consumer(shm_name, slow ? options.slow_consumer_ms : 0).dump();
+            if (write(fds[1], out.data(), out.size()) < 0) _exit(1);
+            _exit(0);
+        }
+        close(fds[1]);
+        children.push_back({pid, fds[0], slow});
+    }
+
+    // Source planes with an OBS-like padded linesize so the strided copy path is exercised
+    const uint32_t linesize = (options.width + 63) & ~63U;
+    std::vector<uint8_t> y(static_cast<size_t>(linesize) * options.height, 0x80);
+    std::vector<uint8_t> uv(static_cast<size_t>(linesize) * options.height / 2, 0x80);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // let consumers map the ring
+
+    LatencyHistogram publish_us;
+    const auto interval = options.fps > 0 ? std::chrono::nanoseconds(1000000000LL / options.fps)
+                                          : std::chrono::nanoseconds(0);
+    const auto start = Clock::now();
+    const auto deadline = start + std::chrono::seconds(options.duration_s);
+    auto next = start;
+
+    while (Clock::now() < deadline) {
+        const uint64_t frame = writer.frames_published();
+        std::memcpy(y.data(), &frame, sizeof(frame));
+        // Last 8 bytes of the packed frame are the last 8 pixels of the last UV row
+        std::memcpy(uv.data() + static_cast<size_t>(linesize) * (options.height / 2 - 1) + options.width - sizeof(frame),
+                    &frame, sizeof(frame));
+
+        const uint64_t started = frame_tap_now_ns();
+        writer.publish(y.data(), linesize, uv.data(), linesize, started);
+        publish_us.record((frame_tap_now_ns() - started) / 1000);
+
+        if (options.fps > 0) {
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    const uint64_t published = writer.frames_published();
+    const uint64_t frame_bytes = writer.get_frame_bytes();
+    writer.close();
+
+    json result;
+    result["width"] = options.width;
+    result["height"] = options.height;
+    result["slots"] = options.slots;
+    result["target_fps"] = options.fps;
+    result["producer"] = {
+        {"frames", published},
+        {"fps", static_cast<double>(published) / elapsed},
+        {"gbytes_per_sec", static_cast<double>(published) * static_cast<double>(frame_bytes) / elapsed / 1e9},
+        {"publish_ms", histogram_ms(publish_us)}
+    };
+
+    bool ok = true;
+    result["consumers"] = json::array();
+    for (const auto& child : children) {
+        std::string out;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = read(child.fd, buffer, sizeof(buffer))) > 0) out.append(buffer, static_cast<size_t>(n));
+        close(child.fd);
+        waitpid(child.pid, nullptr, 0);
+
+        json consumer = json::parse(out, nullptr, false);
+        if (consumer.is_discarded() || consumer.contains("error") || consumer["corrupt"].get<uint64_t>() > 0) ok = false;
+        consumer["slow"] = child.slow;
+        result["consumers"].push_back(consumer);
+    }
+
+    std::cout << result.dump(2) << std::endl;
+    return ok ? 0 : 1;
+}
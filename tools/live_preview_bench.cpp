@@ -0,0 +1,205 @@
+// live_preview_bench.cpp - LL-HLS preview window under a synthetic encoder and N blocking viewers.
+// The producer pushes H.264-shaped packets (keyframe every 2 s) and AAC-sized audio at the
+// recording cadence; each viewer follows the live edge like an LL-HLS player, blocking on the
+// next part. Every frame carries its capture time, so viewers measure capture-to-receipt.
+// Runs once with a single viewer and once with N to show held memory does not follow the audience.
+#include "../third_party/json.hpp"
+#include "../live_preview_window.h"
+#include "../latency_histogram.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+#include <time.h>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    int viewers = 24;
+    int slow_viewers = 4;           // fetch every part but sleep a part duration in between
+    int fps = 30;
+    int duration_s = 20;
+    int bitrate_kbps = 4000;
+    int max_mb = 24;
+};
+
+static uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Annex B access unit: one NAL whose first 8 payload bytes are the capture time
+static std::vector<uint8_t> make_frame(bool keyframe, size_t size, uint64_t capture_ns, std::mt19937& rng) {
+    std::vector<uint8_t> frame(4 + 1 + 8 + size);
+    frame[3] = 1;
+    frame[4] = keyframe ? 0x65 : 0x41;
+    std::memcpy(frame.data() + 5, &capture_ns, 8);
+    for (size_t i = 13; i < frame.size(); ++i) frame[i] = static_cast<uint8_t>(rng() | 0x80);    // no start codes
+    return frame;
+}
+
+// First video sample of a part: moof, then mdat header, 4-byte NAL length, NAL header, stamp
+static uint64_t part_capture_ns(const std::vector<uint8_t>& part) {
+    const uint32_t moof = (uint32_t(part[0]) << 24) | (uint32_t(part[1]) << 16) | (uint32_t(part[2]) << 8) | part[3];
+    uint64_t stamp = 0;
+    if (moof + 8 + 4 + 1 + 8 <= part.size()) std::memcpy(&stamp, part.data() + moof + 8 + 4 + 1, 8);
+    return stamp;
+}
+
+static json run(const BenchOptions& options, int viewers) {
+    LivePreviewConfig config;
+    config.max_bytes = static_cast<size_t>(options.max_mb) << 20;
+    LivePreviewWindow window(config);
+
+    // SPS (High, level 4.0) + PPS; only the header bytes matter to the muxer
+    const uint8_t header[] = {0, 0, 0, 1, 0x67, 0x64, 0x00, 0x28, 0xAC, 0xD9, 0x40,
+                              0, 0, 0, 1, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0};
+    const uint8_t audio_config[] = {0x11, 0x90};    // AAC-LC, 48 kHz, stereo
+    window.configure(header, sizeof(header), 1920, 1080, audio_config, sizeof(audio_config), 48000);
+
+    std::atomic<bool> running{true};
+    size_t peak_held = 0;
+    std::atomic<uint64_t> parts_received{0};
+    std::atomic<uint64_t> busy{0};
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> fell_behind{0};
+    LatencyHistogram capture_to_viewer_us;
+
+    std::thread producer([&] {
+        std::mt19937 rng(42);
+        const auto interval = std::chrono::nanoseconds(1000000000LL / options.fps);
+        const size_t frame_bytes = static_cast<size_t>(options.bitrate_kbps) * 125 / options.fps;
+        const int64_t ticks_per_frame = CmafMuxer::VIDEO_TIMESCALE / options.fps;
+        const int64_t offset = 10 * CmafMuxer::VIDEO_TIMESCALE;
+        int64_t audio_dts = 10 * 48000;
+        std::vector<uint8_t> audio(320);
+        auto next = Clock::now();
+        for (int64_t frame = 0; running; ++frame) {
+            std::this_thread::sleep_until(next);
+            next += interval;
+            const bool keyframe = frame % (2 * options.fps) == 0;
+            const uint64_t captured = now_ns();
+            // x264 lookahead + encode before the packet reaches the output
+            const auto data = make_frame(keyframe, keyframe ? frame_bytes * 4 : frame_bytes * 9 / 10, captured, rng);
+            const int64_t dts = offset + frame * ticks_per_frame;
+            window.push_video(data.data(), data.size(), dts, dts, keyframe, captured, now_ns());
+            while (audio_dts < 10 * 48000 + (frame + 1) * 48000 / options.fps) {
+                window.push_audio(audio.data(), audio.size(), audio_dts, 1024);
+                audio_dts += 1024;
+            }
+            peak_held = std::max(peak_held, window.get_held_bytes());
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (int v = 0; v < viewers; ++v) {
+        const bool slow = v < std::min(options.slow_viewers, viewers);
+        threads.emplace_back([&, slow] {
+            unsigned long long msn = 0;
+            unsigned part = 0;
+            // Join like a player: playlist, then follow the preload hint
+            auto join = [&] {
+                std::shared_ptr<const std::string> playlist;
+                while (running && window.get_playlist(-1, -1, Clock::now() + std::chrono::seconds(6), playlist) != PreviewResult::OK) {
+                }
+                if (!playlist) return false;
+                return std::sscanf(playlist->c_str() + playlist->rfind("URI=\"part_"), "URI=\"part_%llu_%u", &msn, &part) == 2;
+            };
+            if (!join()) return;
+
+            while (running) {
+                PreviewBuffer data;
+                const PreviewResult result = window.get_part(msn, part, Clock::now() + std::chrono::seconds(6), data);
+                if (result == PreviewResult::OK) {
+                    const uint64_t stamp = part_capture_ns(*data);
+                    if (stamp) capture_to_viewer_us.record((now_ns() - stamp) / 1000);
+                    parts_received++;
+                    part++;
+                    if (slow) std::this_thread::sleep_for(std::chrono::milliseconds(config.part_target_ms));
+                } else if (result == PreviewResult::NOT_FOUND && part > 0) {
+                    // Past the last part of a finished segment
+                    msn++;
+                    part = 0;
+                } else if (result == PreviewResult::NOT_FOUND) {
+                    // The segment was evicted before we got to it
+                    fell_behind++;
+                    if (!join()) return;
+                } else if (result == PreviewResult::BUSY) {
+                    busy++;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(config.part_target_ms / 4));
+                } else if (result == PreviewResult::TIMEOUT) {
+                    timeouts++;
+                }
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(options.duration_s));
+    running = false;
+    producer.join();
+    window.close();
+    for (auto& t : threads) t.join();
+
+    const json status = window.get_status();
+    const double hold_back_ms = status["part_hold_back_ms"].get<double>();
+    json result;
+    result["viewers"] = viewers;
+    result["parts_published"] = status["parts_published"];
+    result["parts_received"] = parts_received.load();
+    result["peak_held_bytes"] = peak_held;
+    result["max_bytes"] = config.max_bytes;
+    result["segments_in_window"] = status["segments"];
+    result["evicted_by_age"] = status["evicted_by_age"];
+    result["buffer_pool"] = status["buffer_pool"];
+    result["busy_retries"] = busy.load();
+    result["timeouts"] = timeouts.load();
+    result["fell_behind"] = fell_behind.load();
+    result["capture_to_part_ms"] = status["capture_to_part_ms"];
+    result["capture_to_viewer_ms"] = {{"p50", capture_to_viewer_us.percentile(0.50) / 1000.0},
+                                      {"p99", capture_to_viewer_us.percentile(0.99) / 1000.0},
+                                      {"max", capture_to_viewer_us.max() / 1000.0}};
+    // A player holding back PART-HOLD-BACK from the live edge
+    result["estimated_playback_latency_ms"] = capture_to_viewer_us.percentile(0.50) / 1000.0 + hold_back_ms;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        if (arg == "--viewers") options.viewers = std::atoi(argv[i + 1]);
+        else if (arg == "--slow-viewers") options.slow_viewers = std::atoi(argv[i + 1]);
+        else if (arg == "--fps") options.fps = std::atoi(argv[i + 1]);
+        else if (arg == "--duration") options.duration_s = std::atoi(argv[i + 1]);
+        else if (arg == "--bitrate-kbps") options.bitrate_kbps = std::atoi(argv[i + 1]);
+        else if (arg == "--max-mb") options.max_mb = std::atoi(argv[i + 1]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--viewers N] [--slow-viewers N] [--fps N] [--duration S]"
+                      << " [--bitrate-kbps N] [--max-mb N]" << std::endl;
+            return 2;
+        }
+    }
+    if (options.viewers <= 0 || options.fps <= 0 || options.duration_s <= 0 || options.bitrate_kbps <= 0) return 2;
+
+    json result;
+    result["fps"] = options.fps;
+    result["bitrate_kbps"] = options.bitrate_kbps;
+    result["duration_seconds"] = options.duration_s;
+    result["single_viewer"] = run(options, 1);
+    result["many_viewers"] = run(options, options.viewers);
+    std::cout << result.dump(2) << std::endl;
+
+    // Memory bounded regardless of audience, and a player at PART-HOLD-BACK stays under 2 s
+    const json& many = result["many_viewers"];
+    const bool bounded = many["peak_held_bytes"].get<size_t>() <= many["max_bytes"].get<size_t>();
+    const bool fast = many["estimated_playback_latency_ms"].get<double>() < 2000.0;
+    return bounded && fast ? 0 : 1;
+}
@@ -0,0 +1,340 @@
+// recorder_loadgen.cpp - Open-loop HTTP load generator for the recording API with per-route latency percentiles
+// With --in-process the real RecordingManager serves the API on top of the OBS fake in tools/fake_obs
+#define SCREENRECORDER_NO_MAIN
+#include "../main.cpp"
+#include "fake_obs/obs_fake.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+
+enum class Route {
+    START,
+    PAUSE,
+    STATUS,
+    LIST,
+    STOP,
+    COUNT
+};
+
+static const char* route_name(Route route) {
+    switch (route) {
+        case Route::START: return "start";
+        case Route::PAUSE: return "pause";
+        case Route::STATUS: return "status";
+        case Route::LIST: return "list";
+        case Route::STOP: return "stop";
+        default: return "unknown";
+    }
+}
+
+struct LoadgenOptions {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    double rate = 200.0;          // total requests per second across all connections
+    int duration_seconds = 30;
+    int connections = 8;
+    int stream_pool = 32;
+    std::map<Route, int> mix = {
+        {Route::START, 8}, {Route::PAUSE, 4}, {Route::STATUS, 70}, {Route::LIST, 10}, {Route::STOP, 8}
+    };
+    bool in_process = false;
+    std::string output_path;
+};
+
+struct RouteStats {
+    std::vector<uint64_t> latencies_us;
+    std::map<int, uint64_t> status_codes;
+    uint64_t transport_errors = 0;
+};
+
+static void print_usage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " [options]\n"
+              << "  --host HOST             target host (default 127.0.0.1)\n"
+              << "  --port PORT             target port (default 8080)\n"
+              << "  --rate RPS              total target request rate (default 200)\n"
+              << "  --duration SECONDS      run time (default 30)\n"
+              << "  --connections N         persistent connections/worker threads (default 8)\n"
+              << "  --streams N             size of the stream id pool (default 32)\n"
+              << "  --mix start=8,pause=4,status=70,list=10,stop=8\n"
+              << "                          relative weights per route\n"
+              << "  --in-process            serve the real recorder on the OBS fake in-process on --port\n"
+              << "  --output FILE           write the JSON report to FILE as well as stdout\n";
+}
+
+static bool parse_mix(const std::string& spec, std::map<Route, int>& mix) {
+    std::map<Route, int> parsed;
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        const std::string item = spec.substr(pos, comma - pos);
+        const size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+
+        const std::string name = item.substr(0, eq);
+        const int weight = std::atoi(item.substr(eq + 1).c_str());
+        bool known = false;
+        for (int r = 0; r < static_cast<int>(Route::COUNT); ++r) {
+            if (name == route_name(static_cast<Route>(r))) {
+                parsed[static_cast<Route>(r)] = std::max(weight, 0);
+                known = true;
+            }
+        }
+        if (!known) return false;
+        pos = comma + 1;
+    }
+    mix = parsed;
+    return !mix.empty();
+}
+
+static bool parse_args(int argc, char* argv[], LoadgenOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << name << std::endl;
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        const char* v = nullptr;
+        if (arg == "--host" && (v = value("--host"))) options.host = v;
+        else if (arg == "--port" && (v = value("--port"))) options.port = std::atoi(v);
+        else if (arg == "--rate" && (v = value("--rate"))) options.rate = std::atof(v);
+        else if (arg == "--duration" && (v = value("--duration"))) options.duration_seconds = std::atoi(v);
+        else if (arg == "--connections" && (v = value("--connections"))) options.connections = std::atoi(v);
+        else if (arg == "--streams" && (v = value("--streams"))) options.stream_pool = std::atoi(v);
+        else if (arg == "--mix" && (v = value("--mix"))) {
+            if (!parse_mix(v, options.mix)) {
+                std::cerr << "Invalid --mix: " << v << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--in-process") options.in_process = true;
+        else if (arg == "--output" && (v = value("--output"))) options.output_path = v;
+        else {
+            if (arg != "--help" && arg != "-h") std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    return options.rate > 0 && options.duration_seconds > 0 && options.connections > 0 && options.stream_pool > 0;
+}
+
+static httplib::Result send_request(httplib::Client& client, Route route, const std::string& stream_id) {
+    const std::string base = "/v1/stream/" + stream_id;
+    switch (route) {
+        case Route::START: return client.Post(base + "/start");
+        case Route::PAUSE: return client.Put(base + "/pause");
+        case Route::STATUS: return client.Get(base + "/status");
+        case Route::LIST: return client.Get("/v1/streams");
+        case Route::STOP: return client.Delete(base + "/stop");
+        default: return client.Get("/health");
+    }
+}
+
+// One persistent connection issuing requests on a fixed schedule. Latency is measured from the
+// scheduled send time, so a stalled server shows up as queueing delay instead of being hidden
+// by the client slowing down (coordinated omission).
+static void run_worker(const LoadgenOptions& options, int worker_id, Clock::time_point start,
+                       std::vector<RouteStats>& stats, uint64_t& unsent) {
+    httplib::Client client(options.host, options.port);
+    client.set_keep_alive(true);
+    client.set_tcp_nodelay(true);
+    client.set_connection_timeout(5, 0);
+    client.set_read_timeout(30, 0);
+
+    std::vector<Route> routes;
+    std::vector<int> weights;
+    for (const auto& [route, weight] : options.mix) {
+        routes.push_back(route);
+        weights.push_back(weight);
+    }
+    std::mt19937 rng(0x5eed + worker_id);
+    std::discrete_distribution<size_t> pick_route(weights.begin(), weights.end());
+    std::uniform_int_distribution<int> pick_stream(0, options.stream_pool - 1);
+
+    const double worker_rate = options.rate / options.connections;
+    const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / worker_rate));
+    // Stagger workers so they don't fire in lockstep
+    auto scheduled = start + interval * worker_id / options.connections;
+    const auto end = start + std::chrono::seconds(options.duration_seconds);
+
+    while (scheduled < end) {
+        std::this_thread::sleep_until(scheduled);
+
+        // A saturated server would otherwise keep us draining the backlog long after the run;
+        // count what we never got to send instead.
+        if (Clock::now() >= end) {
+            unsent = static_cast<uint64_t>((end - scheduled) / interval) + 1;
+            break;
+        }
+
+        const Route route = routes[pick_route(rng)];
+        const std::string stream_id = "loadgen-" + std::to_string(pick_stream(rng));
+        auto result = send_request(client, route, stream_id);
+        const auto done = Clock::now();
+
+        RouteStats& route_stats = stats[static_cast<size_t>(route)];
+        if (result) {
+            route_stats.status_codes[result->status]++;
+            route_stats.latencies_us.push_back(
+                std::chrono::duration_cast<std::chrono::microseconds>(done - scheduled).count());
+        } else {
+            route_stats.transport_errors++;
+        }
+
+        scheduled += interval;
+    }
+}
+
+static double percentile_ms(const std::vector<uint64_t>& sorted_us, double p) {
+    if (sorted_us.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(p * static_cast<double>(sorted_us.size()));
+    rank = std::min(rank, sorted_us.size() - 1);
+    return static_cast<double>(sorted_us[rank]) / 1000.0;
+}
+
+static json build_report(const LoadgenOptions& options, std::vector<RouteStats>& merged, uint64_t unsent,
+                         double elapsed_seconds) {
+    json report;
+    report["target"] = options.host + ":" + std::to_string(options.port);
+    report["in_process"] = options.in_process;
+    report["target_rate_rps"] = options.rate;
+    report["connections"] = options.connections;
+    report["stream_pool"] = options.stream_pool;
+    report["elapsed_seconds"] = elapsed_seconds;
+
+    uint64_t total = 0;
+    json routes = json::object();
+    for (int r = 0; r < static_cast<int>(Route::COUNT); ++r) {
+        RouteStats& s = merged[r];
+        if (s.latencies_us.empty() && s.transport_errors == 0) continue;
+
+        std::sort(s.latencies_us.begin(), s.latencies_us.end());
+        uint64_t sum = 0;
+        for (uint64_t v : s.latencies_us) sum += v;
+
+        json route;
+        route["requests"] = s.latencies_us.size();
+        route["transport_errors"] = s.transport_errors;
+        route["throughput_rps"] = static_cast<double>(s.latencies_us.size()) / elapsed_seconds;
+        json codes = json::object();
+        for (const auto& [code, count] : s.status_codes) codes[std::to_string(code)] = count;
+        route["status_codes"] = codes;
+        route["latency_ms"] = {
+            {"p50", percentile_ms(s.latencies_us, 0.50)},
+            {"p99", percentile_ms(s.latencies_us, 0.99)},
+            {"p999", percentile_ms(s.latencies_us, 0.999)},
+            {"max", s.latencies_us.empty() ? 0.0 : static_cast<double>(s.latencies_us.back()) / 1000.0},
+            {"mean", s.latencies_us.empty() ? 0.0 : static_cast<double>(sum) / s.latencies_us.size() / 1000.0}
+        };
+        routes[route_name(static_cast<Route>(r))] = route;
+        total += s.latencies_us.size();
+    }
+
+    report["routes"] = routes;
+    report["total_requests"] = total;
+    report["unsent_requests"] = unsent;
+    report["total_throughput_rps"] = static_cast<double>(total) / elapsed_seconds;
+    return report;
+}
+
+int main(int argc, char* argv[]) {
+    LoadgenOptions options;
+    if (!parse_args(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    std::unique_ptr<RecordingManager> manager;
+    std::thread server_thread;
+    // The recorder logs to stdout, which carries the report
+    std::streambuf* const stdout_buffer = std::cout.rdbuf();
+    if (options.in_process) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+
+        // The startup benchmark would otherwise measure the fake for over a minute
+        EncoderCalibrator::getInstance()->cancel();
+        manager = std::make_unique<RecordingManager>();
+        manager->wait_for_calibration();
+        server_thread = std::thread([&manager, &options] { manager->start_server(options.host, options.port); });
+
+        httplib::Client client(options.host, options.port);
+        bool up = false;
+        for (int attempt = 0; attempt < 100 && !(up = static_cast<bool>(client.Get("/health"))); ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        if (!up) {
+            std::cerr << "In-process recorder failed to listen on " << options.host << ":" << options.port << std::endl;
+            manager->stop_server();
+            server_thread.join();
+            manager.reset();
+            OBSCore::getInstance()->shutdown();
+            std::cout.rdbuf(stdout_buffer);
+            return 1;
+        }
+    }
+
+    std::cerr << "Driving " << options.rate << " req/s over " << options.connections
+              << " connections for " << options.duration_seconds << "s" << std::endl;
+
+    std::vector<std::vector<RouteStats>> per_worker(options.connections,
+                                                    std::vector<RouteStats>(static_cast<size_t>(Route::COUNT)));
+    std::vector<uint64_t> unsent(options.connections, 0);
+    std::vector<std::thread> workers;
+    const auto start = Clock::now() + std::chrono::milliseconds(100);
+    for (int i = 0; i < options.connections; ++i) {
+        workers.emplace_back(run_worker, std::cref(options), i, start, std::ref(per_worker[i]), std::ref(unsent[i]));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (manager) {
+        manager->stop_server();
+        server_thread.join();
+        manager.reset();
+        OBSCore::getInstance()->shutdown();
+        std::cout.rdbuf(stdout_buffer);
+    }
+
+    std::vector<RouteStats> merged(static_cast<size_t>(Route::COUNT));
+    for (auto& worker_stats : per_worker) {
+        for (size_t r = 0; r < merged.size(); ++r) {
+            auto& dst = merged[r];
+            auto& src = worker_stats[r];
+            dst.latencies_us.insert(dst.latencies_us.end(), src.latencies_us.begin(), src.latencies_us.end());
+            for (const auto& [code, count] : src.status_codes) dst.status_codes[code] += count;
+            dst.transport_errors += src.transport_errors;
+        }
+    }
+
+    uint64_t total_unsent = 0;
+    for (uint64_t n : unsent) total_unsent += n;
+
+    const json report = build_report(options, merged, total_unsent, elapsed);
+    std::cout << report.dump(2) << std::endl;
+
+    if (!options.output_path.empty()) {
+        std::ofstream out(options.output_path, std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to write report to " << options.output_path << std::endl;
+            return 1;
+        }
+        out << report.dump(2) << std::endl;
+    }
+
+    return 0;
+}
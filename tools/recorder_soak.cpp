@@ -0,0 +1,787 @@
+// recorder_soak.cpp - Start/pause/stop soak of the real RecordingManager/StreamRecorder, gating on
+// resource growth. main.cpp is compiled in as-is and linked against the OBS fake (fake_obs/), which
+// keeps a live count per OBS object kind. Thousands of randomized cycles go through the HTTP routes,
+// mixing display, region and window capture with egress, frame tap and live preview requests, while
+// the fake fails source/encoder creation, output starts and view setup so the partial-setup cleanup
+// paths get as much traffic as the happy path. Workers stop at every sample boundary, so each sample
+// is taken with no stream open: anything still held then (heap, RSS, fds, threads, channel slots,
+// OBS objects, frame tap segments) leaked. A final phase drains a few live streams the way SIGTERM
+// does. The JSON report has one sample per boundary; pass the previous release's report as
+// --baseline to diff the trend.
+#define SCREENRECORDER_NO_MAIN
+#include "../main.cpp"
+#include "fake_obs/obs_fake.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <random>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <streambuf>
+#include <dirent.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Every operator new in the process (httplib, json, the recorder, the OBS fake) goes through here
+namespace heap {
+constexpr size_t HEADER = alignof(std::max_align_t);
+std::atomic<int64_t> live_bytes{0};
+std::atomic<int64_t> live_blocks{0};
+std::atomic<uint64_t> allocations{0};
+
+void* allocate(size_t size) {
+    auto* base = static_cast<char*>(std::malloc(size + HEADER));
+    if (!base) return nullptr;
+    *reinterpret_cast<size_t*>(base) = size;
+    live_bytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    live_blocks.fetch_add(1, std::memory_order_relaxed);
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return base + HEADER;
+}
+
+void release(void* ptr) {
+    if (!ptr) return;
+    char* base = static_cast<char*>(ptr) - HEADER;
+    live_bytes.fetch_sub(static_cast<int64_t>(*reinterpret_cast<size_t*>(base)), std::memory_order_relaxed);
+    live_blocks.fetch_sub(1, std::memory_order_relaxed);
+    std::free(base);
+}
+}
+
+void* operator new(size_t size) {
+    if (void* ptr = heap::allocate(size)) return ptr;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    if (void* ptr = heap::allocate(size)) return ptr;
+    throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return heap::allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return heap::allocate(size); }
+void operator delete(void* ptr) noexcept { heap::release(ptr); }
+void operator delete[](void* ptr) noexcept { heap::release(ptr); }
+void operator delete(void* ptr, size_t) noexcept { heap::release(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { heap::release(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { heap::release(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { heap::release(ptr); }
+
+struct SoakOptions {
+    int cycles = 5000;
+    int workers = 4;
+    int streams_per_cycle = 3;      // opened together in one cycle, so channel slots are contended
+    int sample_every = 250;
+    int warmup_cycles = -1;         // -1 = from the first sample where RSS has levelled off
+    int fail_sources_percent = 10;
+    int fail_encoding_percent = 10;
+    int fail_output_start_percent = 5;
+    int fail_view_percent = 5;
+    int drain_streams = 6;          // opened for the final drain phase; 0 skips it
+    uint32_t seed = 1;
+    bool verbose = false;           // keep the recorder's own logging
+    // Growth allowed between the baseline sample and the last one; RSS is gated on the growth its
+    // fitted slope implies over that span, so one high or low sample cannot fail or pass a run
+    int64_t max_rss_growth_kb = 4096;
+    int64_t max_heap_growth_kb = 256;
+    int64_t max_fd_growth = 2;
+    int64_t max_thread_growth = 2;
+    std::string report_path;
+    std::string baseline_path;
+};
+
+static void print_usage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " [options]\n"
+              << "  --cycles N              start/pause/stop cycles (default 5000)\n"
+              << "  --workers N             concurrent HTTP clients (default 4)\n"
+              << "  --streams-per-cycle N   streams opened per cycle (default 3)\n"
+              << "  --sample-every N        cycles between samples (default 250)\n"
+              << "  --warmup N              cycles before the baseline sample (default: where RSS levels off)\n"
+              << "  --fail-sources PCT      obs_source_create() failure rate (default 10)\n"
+              << "  --fail-encoding PCT     encoder creation failure rate (default 10)\n"
+              << "  --fail-output-start PCT obs_output_start() failure rate (default 5)\n"
+              << "  --fail-view PCT         obs_view_add2() failure rate (default 5)\n"
+              << "  --drain-streams N       streams left open for the final drain (default 6)\n"
+              << "  --seed N                failure injection and route mix seed (default 1)\n"
+              << "  --verbose               keep the recorder's own stdout/stderr logging\n"
+              << "  --max-rss-growth-kb N   growth implied by the fitted RSS slope (default 4096)\n"
+              << "  --max-heap-growth-kb N  (default 256)\n"
+              << "  --max-fd-growth N       (default 2)\n"
+              << "  --max-thread-growth N   (default 2)\n"
+              << "  --report FILE           write the JSON trend report to FILE as well as stdout\n"
+              << "  --baseline FILE         previous report to diff growth and slopes against\n";
+}
+
+static bool parse_args(int argc, char* argv[], SoakOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << name << std::endl;
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        const char* v = nullptr;
+        if (arg == "--cycles" && (v = value("--cycles"))) options.cycles = std::atoi(v);
+        else if (arg == "--workers" && (v = value("--workers"))) options.workers = std::atoi(v);
+        else if (arg == "--streams-per-cycle" && (v = value("--streams-per-cycle"))) options.streams_per_cycle = std::atoi(v);
+        else if (arg == "--sample-every" && (v = value("--sample-every"))) options.sample_every = std::atoi(v);
+        else if (arg == "--warmup" && (v = value("--warmup"))) options.warmup_cycles = std::atoi(v);
+        else if (arg == "--fail-sources" && (v = value("--fail-sources"))) options.fail_sources_percent = std::atoi(v);
+        else if (arg == "--fail-encoding" && (v = value("--fail-encoding"))) options.fail_encoding_percent = std::atoi(v);
+        else if (arg == "--fail-output-start" && (v = value("--fail-output-start"))) options.fail_output_start_percent = std::atoi(v);
+        else if (arg == "--fail-view" && (v = value("--fail-view"))) options.fail_view_percent = std::atoi(v);
+        else if (arg == "--drain-streams" && (v = value("--drain-streams"))) options.drain_streams = std::atoi(v);
+        else if (arg == "--seed" && (v = value("--seed"))) options.seed = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+        else if (arg == "--verbose") options.verbose = true;
+        else if (arg == "--max-rss-growth-kb" && (v = value("--max-rss-growth-kb"))) options.max_rss_growth_kb = std::atoll(v);
+        else if (arg == "--max-heap-growth-kb" && (v = value("--max-heap-growth-kb"))) options.max_heap_growth_kb = std::atoll(v);
+        else if (arg == "--max-fd-growth" && (v = value("--max-fd-growth"))) options.max_fd_growth = std::atoll(v);
+        else if (arg == "--max-thread-growth" && (v = value("--max-thread-growth"))) options.max_thread_growth = std::atoll(v);
+        else if (arg == "--report" && (v = value("--report"))) options.report_path = v;
+        else if (arg == "--baseline" && (v = value("--baseline"))) options.baseline_path = v;
+        else {
+            if (arg != "--help" && arg != "-h") std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    return options.cycles > 0 && options.workers > 0 && options.streams_per_cycle > 0 &&
+           options.sample_every > 0 && options.warmup_cycles < options.cycles && options.drain_streams >= 0;
+}
+
+// /proc is Linux-only; elsewhere RSS and threads read -1 and are not gated
+static int64_t rss_kb() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    int64_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+    return -1;
+}
+
+static int64_t count_entries(const char* path) {
+    DIR* dir = opendir(path);
+    if (!dir) return -1;
+    int64_t count = 0;
+    while (const dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+static int64_t open_fds() {
+#ifdef __linux__
+    return count_entries("/proc/self/fd");
+#else
+    return count_entries("/dev/fd");
+#endif
+}
+
+static int64_t thread_count() {
+#ifdef __linux__
+    return count_entries("/proc/self/task");
+#else
+    return -1;
+#endif
+}
+
+// Frame tap rings left in /dev/shm (frame_tap_shm_name() prefix)
+static int64_t tap_segments() {
+#ifdef __linux__
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return -1;
+    int64_t count = 0;
+    while (const dirent* entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, "3clogic_tap_", 12) == 0) count++;
+    }
+    closedir(dir);
+    return count;
+#else
+    return -1;
+#endif
+}
+
+// The recorder logs every start and stop; thousands of cycles of that would bury the report
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// Loopback port nothing is listening on, for RecordingManager::start_server()
+static int free_port() {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    int port = -1;
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+        getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) == 0) {
+        port = ntohs(addr.sin_port);
+    }
+    close(fd);
+    return port;
+}
+
+// Plain fields, reserved up front: recording a sample must not itself show up as heap growth
+struct Sample {
+    int cycle = 0;
+    double elapsed_s = 0.0;
+    int64_t active_streams = -1;
+    int64_t pending_streams = -1;
+    int64_t channels_in_use = -1;
+    int64_t obs_objects = -1;
+    int64_t tap_segments = -1;
+    int64_t rss_kb = -1;
+    int64_t heap_live_bytes = 0;
+    int64_t heap_live_blocks = 0;
+    uint64_t heap_allocations = 0;
+    int64_t open_fds = -1;
+    int64_t threads = -1;
+
+    json to_json() const {
+        return {
+            {"cycle", cycle}, {"elapsed_s", elapsed_s}, {"active_streams", active_streams},
+            {"pending_streams", pending_streams}, {"channels_in_use", channels_in_use},
+            {"obs_objects", obs_objects}, {"tap_segments", tap_segments}, {"rss_kb", rss_kb}, {"heap_live_bytes", heap_live_bytes},
+            {"heap_live_blocks", heap_live_blocks}, {"heap_allocations", heap_allocations},
+            {"open_fds", open_fds}, {"threads", threads}
+        };
+    }
+};
+
+struct WorkerStats {
+    std::map<std::string, std::map<int, uint64_t>> status_codes;     // route -> HTTP status -> count
+    std::map<std::string, uint64_t> start_failures;                  // error message -> count
+    uint64_t unexpected = 0;
+    std::vector<std::string> unexpected_examples;
+};
+
+class SoakWorker {
+private:
+    httplib::Client client;
+    WorkerStats& stats;
+    std::mt19937 rng;
+    int id;
+
+    bool chance(int percent) {
+        return static_cast<int>(rng() % 100) < percent;
+    }
+
+    // -1 for a transport error, which is always unexpected
+    int call(const char* route, const std::string& method, const std::string& path,
+             std::initializer_list<int> allowed, std::string* error = nullptr, const std::string& body = "") {
+        httplib::Result result = method == "POST" ? client.Post(path, body, "application/json")
+                               : method == "PUT" ? client.Put(path)
+                               : method == "DELETE" ? client.Delete(path)
+                               : client.Get(path);
+        const int status = result ? result->status : -1;
+        stats.status_codes[route][status]++;
+        if (result && error) {
+            const json body = json::parse(result->body, nullptr, false);
+            if (body.is_object() && body.contains("error")) *error = body["error"].get<std::string>();
+        }
+        if (std::find(allowed.begin(), allowed.end(), status) == allowed.end()) {
+            stats.unexpected++;
+            if (stats.unexpected_examples.size() < 10) {
+                stats.unexpected_examples.push_back(method + " " + path + " -> " + std::to_string(status));
+            }
+        }
+        return status;
+    }
+
+public:
+    SoakWorker(int port, int worker_id, uint32_t seed, WorkerStats& worker_stats)
+        : client("127.0.0.1", port), stats(worker_stats), rng(seed * 7919u + worker_id), id(worker_id) {
+        client.set_keep_alive(true);
+        client.set_read_timeout(std::chrono::seconds(30));
+    }
+
+    // A start body covering every teardown path: own-canvas captures (a view), egress (a second
+    // output), frame tap (a raw video connection and a shm ring), or nothing at all
+    std::string start_body() {
+        json body = json::object();
+        const int capture = static_cast<int>(rng() % 100);
+        if (capture < 20) {
+            body["capture"] = {{"type", "region"}, {"display", static_cast<int>(rng() % 2)},
+                               {"x", 64}, {"y", 32}, {"width", 640}, {"height", 360}};
+        } else if (capture < 35) {
+            // 999999 does not exist and falls back to the main display's size
+            body["capture"] = {{"type", "window"}, {"window_id", chance(50) ? 4711 : 999999}};
+        }
+        if (chance(25)) body["egress"] = {{"url", "udp://127.0.0.1:9"}};
+        if (chance(25)) body["frame_tap"] = {{"slots", 2}};
+        return body.empty() ? std::string() : body.dump();
+    }
+
+    // Opens a few streams, pokes them in random order, and stops every one of them; nothing
+    // outlives the cycle
+    void run_cycle(int cycle, int streams) {
+        std::vector<std::string> running;
+        for (int s = 0; s < streams; ++s) {
+            const std::string base = "/v1/stream/soak-" + std::to_string(id) + "-" + std::to_string(s);
+            if (chance(3)) {
+                // Rejected while parsing, before anything is reserved
+                call("start", "POST", base + "/start", {400}, nullptr,
+                     R"({"capture":{"type":"region","display":7,"x":0,"y":0,"width":64,"height":64}})");
+                continue;
+            }
+            std::string error;
+            // Injected OBS failures and channel exhaustion both surface as 500
+            const int status = call("start", "POST", base + "/start", {200, 500}, &error, start_body());
+            if (status == 200) {
+                running.push_back(base);
+            } else if (status == 500) {
+                stats.start_failures[error]++;
+                call("status", "GET", base + "/status", {404});
+                call("stop", "DELETE", base + "/stop", {404});
+            }
+        }
+
+        std::shuffle(running.begin(), running.end(), rng);
+        for (const auto& base : running) {
+            if (chance(30)) call("start", "POST", base + "/start", {409});
+            if (chance(50)) call("status", "GET", base + "/status", {200});
+            if (chance(10)) call("trace", "GET", base + "/trace", {200});
+            // Activates the preview: waits for the encoder headers and the first part
+            if (chance(5)) call("live", "GET", base + "/live/index.m3u8", {200, 503});
+            if (chance(50)) {
+                call("pause", "PUT", base + "/pause", {200});
+                if (chance(25)) call("pause", "PUT", base + "/pause", {400});
+            }
+        }
+        if (cycle % 10 == 0) call("list", "GET", "/v1/streams", {200});
+
+        for (const auto& base : running) {
+            call("stop", "DELETE", base + "/stop", {200});
+            if (chance(20)) call("stop", "DELETE", base + "/stop", {404});
+            if (chance(20)) call("status", "GET", base + "/status", {404});
+        }
+    }
+
+    // Left running for RecordingManager::drain(); returns the streams that started
+    std::vector<std::string> open_for_drain(int streams) {
+        std::vector<std::string> opened;
+        for (int s = 0; s < streams; ++s) {
+            const std::string base = "/v1/stream/drain-" + std::to_string(id) + "-" + std::to_string(s);
+            std::string error;
+            if (call("start", "POST", base + "/start", {200, 500}, &error, start_body()) == 200) {
+                opened.push_back(base);
+            } else {
+                stats.start_failures[error]++;
+            }
+        }
+        return opened;
+    }
+
+    json get_trace(const std::string& base) {
+        httplib::Result result = client.Get(base + "/trace");
+        return result && result->status == 200 ? json::parse(result->body, nullptr, false) : json();
+    }
+};
+
+// Below this RSS growth rate between two samples, pools, arenas and caches have filled up
+static constexpr double RSS_LEVEL_OFF_KB_PER_1000 = 1024.0;
+
+// Least-squares slope of a metric against cycle count, per 1000 cycles
+static double slope_per_1000(const json& samples, const char* metric, size_t from) {
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = from; i < samples.size(); ++i) {
+        const double x = samples[i]["cycle"].get<double>();
+        const double y = samples[i][metric].get<double>();
+        n++;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    const double denominator = n * sxx - sx * sx;
+    return n >= 2 && denominator != 0 ? (n * sxy - sx * sy) / denominator * 1000.0 : 0.0;
+}
+
+int main(int argc, char* argv[]) {
+    SoakOptions options;
+    if (!parse_args(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+#ifdef __GLIBC__
+    // Every stream starts muxer, egress and tap threads; with an arena per thread, RSS tracks
+    // fragmentation across arenas rather than what is still allocated
+    mallopt(M_ARENA_MAX, 1);
+#endif
+
+    NullBuffer null_buffer;
+    std::streambuf* const stdout_buffer = std::cout.rdbuf();
+    std::streambuf* const stderr_buffer = std::cerr.rdbuf();
+    if (!options.verbose) {
+        std::cout.rdbuf(&null_buffer);
+        std::cerr.rdbuf(&null_buffer);
+    }
+
+    FakeObs::set_seed(options.seed);
+    FakeObs::set_failure_percent(FakeObsFailure::SOURCE_CREATE, options.fail_sources_percent);
+    FakeObs::set_failure_percent(FakeObsFailure::ENCODER_CREATE, options.fail_encoding_percent);
+    FakeObs::set_failure_percent(FakeObsFailure::OUTPUT_START, options.fail_output_start_percent);
+    FakeObs::set_failure_percent(FakeObsFailure::VIEW_ADD, options.fail_view_percent);
+
+    // Segments another recorder on this machine already holds are not ours
+    const int64_t foreign_tap_segments = tap_segments();
+    const int port = free_port();
+    if (port < 0) {
+        std::clog << "No free loopback port" << std::endl;
+        return 1;
+    }
+
+    // The startup benchmark would otherwise measure the fake for over a minute; cancelled, it
+    // loads the cache or stops after the idle baseline, and writes nothing
+    EncoderCalibrator::getInstance()->cancel();
+    auto manager = std::make_unique<RecordingManager>();
+    manager->wait_for_calibration();
+    std::thread server_thread([&manager, port]() { manager->start_server("127.0.0.1", port); });
+    httplib::Client monitor("127.0.0.1", port);
+    monitor.set_keep_alive(true);
+    for (int attempt = 0; attempt < 100 && !monitor.Get("/health"); ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    std::clog << "Soaking " << options.cycles << " cycles over " << options.workers << " workers on port "
+              << port << " (fail sources " << options.fail_sources_percent << "%, encoding "
+              << options.fail_encoding_percent << "%, output start " << options.fail_output_start_percent
+              << "%, view " << options.fail_view_percent << "%)" << std::endl;
+
+    // Workers run one batch of cycles at a time and wait at the boundary for the sample
+    std::mutex gate_mutex;
+    std::condition_variable gate;
+    int released_batch = 0;
+    int batch_end = 0;
+    int finished_workers = 0;
+    bool done = false;
+    std::atomic<int> next_cycle{0};
+
+    std::vector<WorkerStats> stats(options.workers);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < options.workers; ++w) {
+        workers.emplace_back([&, w]() {
+            SoakWorker worker(port, w, options.seed, stats[w]);
+            for (int batch = 1;; ++batch) {
+                int end = 0;
+                {
+                    std::unique_lock<std::mutex> lock(gate_mutex);
+                    gate.wait(lock, [&] { return done || released_batch >= batch; });
+                    if (done) return;
+                    end = batch_end;
+                }
+                for (int cycle; (cycle = next_cycle.fetch_add(1)) < end;) {
+                    worker.run_cycle(cycle, options.streams_per_cycle);
+                }
+                std::lock_guard<std::mutex> lock(gate_mutex);
+                finished_workers++;
+                gate.notify_all();
+            }
+        });
+    }
+
+    std::vector<Sample> collected;
+    collected.reserve(static_cast<size_t>(options.cycles / options.sample_every) + 2);
+    const auto started = Clock::now();
+    auto take_sample = [&](int cycle) {
+        Sample sample;
+        sample.cycle = cycle;
+        sample.elapsed_s = std::chrono::duration<double>(Clock::now() - started).count();
+        // Through the API, as an operator would see it
+        if (auto result = monitor.Get("/v1/streams")) {
+            const json streams = json::parse(result->body, nullptr, false);
+            if (streams.is_object()) {
+                sample.active_streams = streams["active_streams"].get<int64_t>();
+                sample.pending_streams = streams["pending_streams"].get<int64_t>();
+                sample.channels_in_use = streams["channels_in_use"].get<int64_t>();
+            }
+        }
+        sample.obs_objects = FakeObs::live_total();
+        sample.tap_segments = tap_segments() - foreign_tap_segments;
+#ifdef __GLIBC__
+        // Free pages left inside the heap after a cycle's streams exit are returned to the OS lazily,
+        // so without this RSS swings by several MB from sample to sample with nothing leaked
+        malloc_trim(0);
+#endif
+        sample.rss_kb = rss_kb();
+        sample.heap_live_bytes = heap::live_bytes.load();
+        sample.heap_live_blocks = heap::live_blocks.load();
+        sample.heap_allocations = heap::allocations.load();
+        sample.open_fds = open_fds();
+        sample.threads = thread_count();
+        collected.push_back(sample);
+    };
+
+    take_sample(0);
+    for (int batch = 1; batch_end < options.cycles; ++batch) {
+        {
+            std::unique_lock<std::mutex> lock(gate_mutex);
+            batch_end = std::min(batch_end + options.sample_every, options.cycles);
+            finished_workers = 0;
+            released_batch = batch;
+            gate.notify_all();
+            gate.wait(lock, [&] { return finished_workers == options.workers; });
+            next_cycle = batch_end;
+        }
+        take_sample(batch_end);
+        std::clog << "  cycle " << batch_end << ": rss " << collected.back().rss_kb << " KB, heap "
+                  << collected.back().heap_live_bytes << " B, fds " << collected.back().open_fds
+                  << ", threads " << collected.back().threads << ", OBS objects " << collected.back().obs_objects
+                  << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lock(gate_mutex);
+        done = true;
+        gate.notify_all();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Shutdown path: streams still recording are stopped by drain(), as on SIGTERM
+    json drain;
+    if (options.drain_streams > 0) {
+        WorkerStats drain_stats;
+        SoakWorker worker(port, options.workers, options.seed, drain_stats);
+        const std::vector<std::string> opened = worker.open_for_drain(options.drain_streams);
+
+        // Long enough for packets to clear the fake encoder's lookahead: every one of them must
+        // find its composite in its own mix's ring, however many views render alongside
+        std::this_thread::sleep_for(std::chrono::milliseconds(3000));
+        json traces = json::array();
+        int64_t traced_frames = 0;
+        int64_t incomplete_frames = 0;
+        for (const auto& base : opened) {
+            const json trace = worker.get_trace(base);
+            if (!trace.is_object()) continue;
+            traced_frames += trace["frames"].get<int64_t>();
+            incomplete_frames += trace["incomplete_frames"].get<int64_t>();
+            traces.push_back({{"stream", base}, {"frames", trace["frames"]},
+                              {"incomplete_frames", trace["incomplete_frames"]}});
+        }
+
+        const json report = manager->drain();
+        drain = {{"opened", opened.size()}, {"traced_frames", traced_frames},
+                 {"incomplete_frames", incomplete_frames}, {"traces", traces}, {"complete", report["complete"]}, {"report", report},
+                 {"active_streams_after", -1}, {"channels_in_use_after", StreamRecorder::channels_in_use()},
+                 {"obs_objects_after", FakeObs::live_total()},
+                 {"tap_segments_after", tap_segments() - foreign_tap_segments}};
+        if (auto result = monitor.Get("/v1/streams")) {
+            const json streams = json::parse(result->body, nullptr, false);
+            if (streams.is_object()) drain["active_streams_after"] = streams["active_streams"];
+        }
+        stats.push_back(std::move(drain_stats));
+    }
+    manager->stop_server();
+    server_thread.join();
+
+    // Recorders and the core go before the fake's own statics, and everything must be gone by then
+    manager.reset();
+    OBSCore::getInstance()->shutdown();
+    const json ledger_at_exit = FakeObs::get_ledger();
+    const int64_t obs_objects_at_exit = FakeObs::live_total();
+    std::cout.rdbuf(stdout_buffer);
+    std::cerr.rdbuf(stderr_buffer);
+
+    json samples = json::array();
+    for (const auto& sample : collected) samples.push_back(sample.to_json());
+
+    // Baseline: the first sample at or after --warmup, or else the first one after which RSS climbs
+    // slower than RSS_LEVEL_OFF_KB_PER_1000. A leak never levels off, so the search stops at the middle
+    // sample and the second half of the run is still measured.
+    size_t baseline_index = 0;
+    if (options.warmup_cycles >= 0) {
+        while (baseline_index + 1 < samples.size() && samples[baseline_index]["cycle"].get<int>() < options.warmup_cycles) {
+            baseline_index++;
+        }
+    } else {
+        const size_t middle = (samples.size() - 1) / 2;
+        baseline_index = std::min<size_t>(1, middle);
+        for (; baseline_index < middle; ++baseline_index) {
+            const json& from = samples[baseline_index];
+            const json& to = samples[baseline_index + 1];
+            const double rate = (to["rss_kb"].get<double>() - from["rss_kb"].get<double>()) * 1000.0 /
+                                (to["cycle"].get<double>() - from["cycle"].get<double>());
+            if (rate <= RSS_LEVEL_OFF_KB_PER_1000) break;
+        }
+    }
+    const json& baseline = samples[baseline_index];
+    const json& last = samples.back();
+
+    json report;
+    report["config"] = {
+        {"cycles", options.cycles},
+        {"workers", options.workers},
+        {"streams_per_cycle", options.streams_per_cycle},
+        {"sample_every", options.sample_every},
+        {"warmup_cycles", baseline["cycle"]},
+        {"warmup", options.warmup_cycles >= 0 ? "fixed" : "rss_levelled_off"},
+        {"fail_sources_percent", options.fail_sources_percent},
+        {"fail_encoding_percent", options.fail_encoding_percent},
+        {"fail_output_start_percent", options.fail_output_start_percent},
+        {"fail_view_percent", options.fail_view_percent},
+        {"drain_streams", options.drain_streams},
+        {"seed", options.seed}
+    };
+    report["duration_seconds"] = std::chrono::duration<double>(Clock::now() - started).count();
+    report["samples"] = samples;
+
+    std::vector<std::string> violations;
+    json growth;
+    const std::vector<std::pair<const char*, int64_t>> gated = {
+        {"rss_kb", options.max_rss_growth_kb},
+        {"heap_live_bytes", options.max_heap_growth_kb * 1024},
+        {"open_fds", options.max_fd_growth},
+        {"threads", options.max_thread_growth}
+    };
+    const int measured_cycles = last["cycle"].get<int>() - baseline["cycle"].get<int>();
+    for (const auto& metric : gated) {
+        const int64_t from = baseline[metric.first].get<int64_t>();
+        const int64_t to = last[metric.first].get<int64_t>();
+        const bool measured = from >= 0 && to >= 0;
+        const double slope = slope_per_1000(samples, metric.first, baseline_index);
+        json entry = {{"baseline", from}, {"final", to}, {"limit", metric.second}, {"slope_per_1000_cycles", slope}};
+        // Heap, fds and threads are exact counts; RSS moves with page reuse, so it is gated on the trend
+        int64_t grew = measured ? to - from : 0;
+        if (measured && std::strcmp(metric.first, "rss_kb") == 0) {
+            entry["endpoint_growth"] = grew;
+            grew = static_cast<int64_t>(slope * measured_cycles / 1000.0);
+        }
+        entry["growth"] = grew;
+        if (grew > metric.second) {
+            violations.push_back(std::string(metric.first) + " grew by " + std::to_string(grew) +
+                                 " (limit " + std::to_string(metric.second) + ")");
+        }
+        growth[metric.first] = entry;
+    }
+    growth["heap_live_blocks"] = {{"baseline", baseline["heap_live_blocks"]}, {"final", last["heap_live_blocks"]},
+                                  {"growth", last["heap_live_blocks"].get<int64_t>() - baseline["heap_live_blocks"].get<int64_t>()},
+                                  {"slope_per_1000_cycles", slope_per_1000(samples, "heap_live_blocks", baseline_index)}};
+    const uint64_t allocations = last["heap_allocations"].get<uint64_t>() - baseline["heap_allocations"].get<uint64_t>();
+    growth["heap_allocations_per_cycle"] = measured_cycles > 0 ? static_cast<double>(allocations) / measured_cycles : 0.0;
+
+    // Every sample is taken between cycles, when nothing may be held
+    for (const auto& sample : samples) {
+        for (const char* held : {"active_streams", "pending_streams", "channels_in_use", "obs_objects", "tap_segments"}) {
+            if (sample[held].get<int64_t>() < 0) {
+                violations.push_back("cycle " + sample["cycle"].dump() + ": /v1/streams unavailable");
+                break;
+            }
+            if (sample[held].get<int64_t>() != 0) {
+                violations.push_back("cycle " + sample["cycle"].dump() + ": " + held + " = " + sample[held].dump());
+            }
+        }
+    }
+
+    WorkerStats merged;
+    for (const auto& worker : stats) {
+        for (const auto& route : worker.status_codes) {
+            for (const auto& code : route.second) merged.status_codes[route.first][code.first] += code.second;
+        }
+        for (const auto& failure : worker.start_failures) merged.start_failures[failure.first] += failure.second;
+        merged.unexpected += worker.unexpected;
+        for (const auto& example : worker.unexpected_examples) {
+            if (merged.unexpected_examples.size() < 10) merged.unexpected_examples.push_back(example);
+        }
+    }
+    json responses;
+    for (const auto& route : merged.status_codes) {
+        for (const auto& code : route.second) responses[route.first][std::to_string(code.first)] = code.second;
+    }
+    if (merged.unexpected > 0) {
+        violations.push_back(std::to_string(merged.unexpected) + " unexpected responses");
+    }
+
+    report["summary"] = growth;
+    report["responses"] = responses;
+    report["start_failures"] = merged.start_failures;
+    report["unexpected_responses"] = merged.unexpected;
+    report["unexpected_examples"] = merged.unexpected_examples;
+    if (!drain.is_null()) {
+        report["drain"] = drain;
+        if (!drain["complete"].get<bool>()) violations.push_back("drain missed its deadline");
+        if (drain["opened"].get<int64_t>() > 0 && drain["traced_frames"].get<int64_t>() == 0) {
+            violations.push_back("drain: no video packets traced");
+        }
+        if (drain["incomplete_frames"].get<int64_t>() != 0) {
+            violations.push_back("drain: " + drain["incomplete_frames"].dump() + " traced frames without a composite stamp");
+        }
+        for (const char* held : {"active_streams_after", "channels_in_use_after", "obs_objects_after", "tap_segments_after"}) {
+            if (drain[held].get<int64_t>() != 0) violations.push_back(std::string("drain: ") + held + " = " + drain[held].dump());
+        }
+    }
+    report["obs_ledger_at_exit"] = ledger_at_exit;
+    report["channels_in_use_at_exit"] = StreamRecorder::channels_in_use();
+    if (obs_objects_at_exit != 0) {
+        violations.push_back("OBS objects alive after shutdown: " + ledger_at_exit.dump());
+    }
+    report["obs_misuse"] = FakeObs::misuse_count();
+    report["obs_misuse_examples"] = FakeObs::get_misuse();
+    if (FakeObs::misuse_count() > 0) {
+        violations.push_back(std::to_string(FakeObs::misuse_count()) + " OBS API misuse(s)");
+    }
+
+    // Diffing against a previous release compares trend, not individual samples
+    if (!options.baseline_path.empty()) {
+        std::ifstream file(options.baseline_path);
+        const json previous = file ? json::parse(file, nullptr, false) : json();
+        if (!previous.is_object() || !previous.contains("summary")) {
+            std::cerr << "Could not read baseline report " << options.baseline_path << std::endl;
+        } else {
+            json comparison;
+            for (const auto& metric : gated) {
+                const json& before = previous["summary"][metric.first];
+                const json& now = growth[metric.first];
+                comparison[metric.first] = {
+                    {"growth", {{"previous", before["growth"]}, {"current", now["growth"]},
+                                {"delta", now["growth"].get<int64_t>() - before["growth"].get<int64_t>()}}},
+                    {"slope_per_1000_cycles", {{"previous", before["slope_per_1000_cycles"]},
+                                               {"current", now["slope_per_1000_cycles"]},
+                                               {"delta", now["slope_per_1000_cycles"].get<double>() -
+                                                         before["slope_per_1000_cycles"].get<double>()}}}
+                };
+            }
+            const double before = previous["summary"]["heap_allocations_per_cycle"].get<double>();
+            const double now = growth["heap_allocations_per_cycle"].get<double>();
+            comparison["heap_allocations_per_cycle"] = {{"previous", before}, {"current", now}, {"delta", now - before}};
+            report["compared_to"] = {{"report", options.baseline_path}, {"config", previous["config"]},
+                                     {"metrics", comparison}};
+        }
+    }
+
+    report["violations"] = violations;
+    report["pass"] = violations.empty();
+
+    std::cout << report.dump(2) << std::endl;
+    if (!options.report_path.empty()) {
+        std::ofstream out(options.report_path);
+        out << report.dump(2) << std::endl;
+    }
+    for (const auto& violation : violations) {
+        std::cerr << "FAIL: " << violation << std::endl;
+    }
+    return violations.empty() ? 0 : 1;
+}
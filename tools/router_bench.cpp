@@ -0,0 +1,151 @@
+// router_bench.cpp - Microbenchmark: httplib regex route matching + per-request CORS headers vs RouteTrie
+#include "../third_party/httplib.h"
+#include "../third_party/json.hpp"
+#include "../route_trie.h"
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdlib>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct BenchRequest {
+    std::string method;
+    std::string path;
+};
+
+// Same patterns and order RecordingManager used to register with httplib
+static const std::vector<std::pair<std::string, std::string>> regex_routes = {
+    {"POST", "/v1/stream/([^/]+)/start"},
+    {"PUT", "/v1/stream/([^/]+)/pause"},
+    {"DELETE", "/v1/stream/([^/]+)/stop"},
+    {"GET", "/v1/stream/([^/]+)/status"},
+    {"GET", "/v1/streams"},
+    {"GET", "/v1/encoder/profile"},
+    {"POST", "/v1/encoder/calibrate"},
+    {"GET", "/v1/metrics"},
+    {"GET", "/health"},
+};
+
+static const std::vector<std::pair<std::string, std::string>> trie_routes = {
+    {"POST", "/v1/stream/:stream_id/start"},
+    {"PUT", "/v1/stream/:stream_id/pause"},
+    {"DELETE", "/v1/stream/:stream_id/stop"},
+    {"GET", "/v1/stream/:stream_id/status"},
+    {"GET", "/v1/streams"},
+    {"GET", "/v1/encoder/profile"},
+    {"POST", "/v1/encoder/calibrate"},
+    {"GET", "/v1/metrics"},
+    {"GET", "/health"},
+};
+
+// Status polling dominates production traffic
+static std::vector<BenchRequest> build_workload() {
+    std::vector<BenchRequest> workload;
+    for (int i = 0; i < 64; ++i) {
+        const std::string id = "agent-" + std::to_string(i) + "-call-7f3a9c";
+        workload.push_back({"GET", "/v1/stream/" + id + "/status"});
+        workload.push_back({"GET", "/v1/stream/" + id + "/status"});
+        workload.push_back({"GET", "/v1/stream/" + id + "/status"});
+        workload.push_back({"GET", "/v1/streams"});
+        workload.push_back({"GET", "/health"});
+        if (i % 8 == 0) {
+            workload.push_back({"POST", "/v1/stream/" + id + "/start"});
+            workload.push_back({"DELETE", "/v1/stream/" + id + "/stop"});
+        }
+    }
+    return workload;
+}
+
+static void set_cors_headers(httplib::Response& res) {
+    res.set_header("Access-Control-Allow-Origin", "*");
+    res.set_header("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
+    res.set_header("Access-Control-Allow-Headers", "Content-Type, Authorization");
+}
+
+static json report(const char* name, Clock::duration elapsed, size_t ops, size_t matched) {
+    const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    json result;
+    result["name"] = name;
+    result["ops"] = ops;
+    result["matched"] = matched;
+    result["ns_per_op"] = ns / static_cast<double>(ops);
+    result["ops_per_sec"] = static_cast<double>(ops) / (ns / 1e9);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    const std::vector<BenchRequest> workload = build_workload();
+    const size_t ops = iterations * workload.size();
+
+    // Regex path: httplib's RegexMatcher list walked in order, then three set_header calls
+    std::vector<std::pair<std::string, std::unique_ptr<httplib::detail::MatcherBase>>> matchers;
+    for (const auto& [method, pattern] : regex_routes) {
+        matchers.emplace_back(method, std::make_unique<httplib::detail::RegexMatcher>(pattern));
+    }
+    size_t regex_matched = 0;
+    const auto regex_start = Clock::now();
+    for (size_t it = 0; it < iterations; ++it) {
+        for (const auto& r : workload) {
+            httplib::Request req;
+            req.method = r.method;
+            req.path = r.path;
+            httplib::Response res;
+            set_cors_headers(res);
+            for (const auto& [method, matcher] : matchers) {
+                if (method == req.method && matcher->match(req)) {
+                    regex_matched += req.matches.size() > 1 ? req.matches[1].length() > 0 : 1;
+                    break;
+                }
+            }
+        }
+    }
+    const auto regex_elapsed = Clock::now() - regex_start;
+
+    // Trie path: one walk with string_view captures, CORS block copied from a prebuilt Headers
+    RouteTrie router;
+    size_t trie_matched = 0;
+    for (const auto& [method, pattern] : trie_routes) {
+        router.add(method == "GET" ? RouteTrie::Method::GET
+                   : method == "POST" ? RouteTrie::Method::POST
+                   : method == "PUT" ? RouteTrie::Method::PUT
+                   : RouteTrie::Method::DELETE,
+                   pattern,
+                   [&trie_matched](const httplib::Request&, httplib::Response&, const RouteParams& params) {
+                       trie_matched += params.count ? params[0].size() > 0 : 1;
+                   });
+    }
+    const httplib::Headers cors = {
+        {"Access-Control-Allow-Origin", "*"},
+        {"Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS"},
+        {"Access-Control-Allow-Headers", "Content-Type, Authorization"}
+    };
+    const auto trie_start = Clock::now();
+    for (size_t it = 0; it < iterations; ++it) {
+        for (const auto& r : workload) {
+            httplib::Request req;
+            req.method = r.method;
+            req.path = r.path;
+            httplib::Response res;
+            res.headers = cors;
+            router.dispatch(req, res);
+        }
+    }
+    const auto trie_elapsed = Clock::now() - trie_start;
+
+    json result;
+    result["workload_requests"] = workload.size();
+    result["iterations"] = iterations;
+    result["regex"] = report("httplib_regex", regex_elapsed, ops, regex_matched);
+    result["trie"] = report("route_trie", trie_elapsed, ops, trie_matched);
+    result["speedup"] = std::chrono::duration<double>(regex_elapsed).count() /
+                        std::chrono::duration<double>(trie_elapsed).count();
+    std::cout << result.dump(2) << std::endl;
+
+    return regex_matched == trie_matched ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+// trace_overhead_bench.cpp - Cost of per-frame pipeline tracing: N stream output threads recording
+// FrameStamps at the target fps against one graphics thread, with a reader polling the
+// per-stream status like the API does. Reports time spent tracing as a share of one core, and
+// checks that matching cts to its composite yields a tick -> composite well under a frame.
+#include "../third_party/json.hpp"
+#include "../pipeline_trace.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdlib>
+#include <time.h>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+static uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+int main(int argc, char* argv[]) {
+    const int streams = argc > 1 ? std::atoi(argv[1]) : 20;
+    const int fps = argc > 2 ? std::atoi(argv[2]) : 30;
+    const int duration_s = argc > 3 ? std::atoi(argv[3]) : 10;
+    if (streams <= 0 || fps <= 0 || duration_s <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [streams=20] [fps=30] [duration_s=10]" << std::endl;
+        return 2;
+    }
+
+    CompositeRing composites;
+    std::atomic<uint64_t> last_frame_time{0};
+    std::vector<std::unique_ptr<PipelineTrace>> traces;
+    for (int i = 0; i < streams; ++i) traces.push_back(std::make_unique<PipelineTrace>());
+
+    std::atomic<bool> running{true};
+    const auto interval = std::chrono::nanoseconds(1000000000LL / fps);
+
+    // Graphics thread: wakes at each frame time, ticks sources and renders (~2-6 ms), then the
+    // main-rendered callback pushes (frame time, render done)
+    std::thread graphics([&] {
+        uint64_t frame_time = now_ns();
+        uint64_t n = 0;
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(frame_time - std::min(frame_time, now_ns())));
+            const uint64_t render_ns = 2000000 + (n++ % 5) * 1000000;
+            while (now_ns() < frame_time + render_ns) {
+            }
+            composites.push(frame_time, now_ns());
+            last_frame_time.store(frame_time, std::memory_order_release);
+            frame_time += static_cast<uint64_t>(interval.count());
+        }
+    });
+
+    // Output threads: the same work trace_packet_callback does per video packet
+    std::vector<std::thread> outputs;
+    for (int i = 0; i < streams; ++i) {
+        outputs.emplace_back([&, i] {
+            PipelineTrace& trace = *traces[i];
+            auto next = Clock::now() + std::chrono::milliseconds(5);
+            int64_t pts = 0;
+            while (running) {
+                std::this_thread::sleep_until(next);
+                next += interval;
+
+                // cts of the newest rendered frame, as OBS stamps it into the packet
+                const uint64_t cts = last_frame_time.load(std::memory_order_acquire);
+                if (!cts) continue;
+                FrameStamps stamps;
+                stamps.mux = now_ns();
+                stamps.pts = pts++;
+                stamps.tick = cts;
+                stamps.composite = composites.composite_for(cts);
+                stamps.encode_request = stamps.composite + 300000;
+                stamps.encode_complete = stamps.composite + 900000;
+                stamps.interleave = stamps.composite + 1200000;
+                trace.record(stamps);
+                trace.add_cost(now_ns() - stamps.mux);
+            }
+        });
+    }
+
+    // API poller: every stream's status five times a second
+    std::thread poller([&] {
+        while (running) {
+            for (const auto& trace : traces) {
+                const std::string body = trace->get_status(1.0).dump();
+                asm volatile("" : : "r"(body.size()));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::seconds(duration_s));
+    running = false;
+    graphics.join();
+    for (auto& t : outputs) t.join();
+    poller.join();
+
+    double cpu_percent = 0.0;
+    double worst_cost_us = 0.0;
+    bool composite_within_frame = true;
+    uint64_t frames = 0;
+    uint64_t incomplete = 0;
+    for (const auto& trace : traces) {
+        const json status = trace->get_status(duration_s);
+        cpu_percent += status["trace_cpu_percent"].get<double>();
+        worst_cost_us = std::max(worst_cost_us, status["trace_cost_us_per_frame"].get<double>());
+        frames += status["frames"].get<uint64_t>();
+        incomplete += status["incomplete_frames"].get<uint64_t>();
+        composite_within_frame = composite_within_frame && trace->composite_within(static_cast<uint64_t>(interval.count()));
+    }
+
+    json result;
+    result["streams"] = streams;
+    result["fps"] = fps;
+    result["duration_seconds"] = duration_s;
+    result["frames"] = frames;
+    result["incomplete_frames"] = incomplete;
+    result["worst_stream_cost_us_per_frame"] = worst_cost_us;
+    result["total_trace_cpu_percent_of_one_core"] = cpu_percent;
+    result["composite_within_frame_interval"] = composite_within_frame;
+    result["sample_stream"] = traces[0]->get_status(duration_s);
+    result["sample_dump_head"] = traces[0]->dump_samples()[0];
+    std::cout << result.dump(2) << std::endl;
+
+    return cpu_percent < 1.0 && composite_within_frame && incomplete == 0 ? 0 : 1;
+}